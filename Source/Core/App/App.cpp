@@ -31,6 +31,7 @@
 #include "Supervisor.h"
 #include "InternalClipboard.h"
 #include "FontSerializer.h"
+#include "BatchRenderer.h"
 #include "FileUtils.h"
 
 #include "MainLayout.h"
@@ -317,6 +318,12 @@ void App::initialise(const String &commandLine)
         fs.run(commandLine);
         this->quit();
     }
+    else if (this->runMode == App::BATCH_RENDER)
+    {
+        this->config = new Config();
+        this->batchRenderer = new BatchRenderer();
+        this->batchRenderer->run(commandLine);
+    }
 }
 
 void App::shutdown()
@@ -359,6 +366,11 @@ void App::shutdown()
     {
 
     }
+    else if (this->runMode == App::BATCH_RENDER)
+    {
+        this->batchRenderer = nullptr;
+        this->config = nullptr;
+    }
 }
 
 const String App::getApplicationName()
@@ -537,6 +549,10 @@ App::RunMode App::detectRunMode(const String &commandLine)
 {
     if (commandLine != "")
     {
+        if (BatchRenderer::isBatchRenderCommandLine(commandLine))
+        {
+            return App::BATCH_RENDER;
+        }
         if (commandLine.contains("-F") && commandLine.contains("-f"))
         {
             return App::FONT_SERIALIZE;
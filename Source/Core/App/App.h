@@ -42,6 +42,7 @@ class Supervisor;
 class UpdateManager;
 class InternalClipboard;
 class AuthorizationManager;
+class BatchRenderer;
 
 class App : public JUCEApplication,
             private AsyncUpdater,
@@ -128,6 +129,7 @@ private:
     ScopedPointer<class MainWindow> window;
     ScopedPointer<AuthorizationManager> authorizationManager;
     ScopedPointer<class Workspace> workspace;
+    ScopedPointer<BatchRenderer> batchRenderer;
 
 private:
 
@@ -143,7 +145,8 @@ private:
     {
         NORMAL,
         PLUGIN_CHECK,
-        FONT_SERIALIZE
+        FONT_SERIALIZE,
+        BATCH_RENDER
     };
 
     App::RunMode detectRunMode(const String &commandLine);
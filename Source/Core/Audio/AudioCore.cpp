@@ -25,8 +25,12 @@
 #include "DataEncoder.h"
 #include "SerializationKeys.h"
 #include "AudioMonitor.h"
+#include "PlaybackScheduler.h"
 #include "AudiobusOutput.h"
 
+// About -100 dB, below which an instrument's output counts as silence
+#define AUDIO_CORE_SILENCE_LEVEL 0.00001f
+
 void AudioCore::initAudioFormats(AudioPluginFormatManager &formatManager)
 {
     formatManager.addDefaultFormats();
@@ -34,12 +38,23 @@ void AudioCore::initAudioFormats(AudioPluginFormatManager &formatManager)
     formatManager.addFormat(new BuiltInSynthFormat());
 }
 
-AudioCore::AudioCore()
+AudioCore::AudioCore() :
+    playbackScheduler(nullptr),
+    sampleRate(44100.0),
+    currentInputChannelData(nullptr),
+    currentNumInputChannels(0),
+    currentNumOutputChannels(0),
+    currentNumSamples(0)
 {
     Logger::writeToLog("AudioCore::AudioCore");
 
+    // workers run at the priority of the device's realtime thread,
+    // and stay parked while there's nothing to share with them
+    this->workerPool = new AudioWorkerPool(AudioWorkerPool::getDefaultNumWorkers(), 10);
+
+    // the monitor is called from our own callback, which goes first
     this->audioMonitor = new AudioMonitor();
-    this->deviceManager.addAudioCallback(this->audioMonitor);
+    this->deviceManager.addAudioCallback(this);
 
     AudioCore::initAudioFormats(this->formatManager);
 
@@ -59,7 +74,7 @@ AudioCore::~AudioCore()
     AudiobusOutput::shutdown();
 #endif
 
-    this->deviceManager.removeAudioCallback(this->audioMonitor);
+    this->deviceManager.removeAudioCallback(this);
     this->audioMonitor = nullptr;
 
     //ScopedPointer<XmlElement> test(this->metaInstrument->serialize());
@@ -87,6 +102,17 @@ void AudioCore::unmute()
     }
 }
 
+void AudioCore::setPlaybackScheduler(PlaybackScheduler *scheduler)
+{
+    const ScopedLock sl(this->deviceManager.getAudioCallbackLock());
+    this->playbackScheduler = scheduler;
+}
+
+int AudioCore::getNumAudioWorkers() const noexcept
+{
+    return this->workerPool->getNumWorkers();
+}
+
 AudioDeviceManager &AudioCore::getDevice() noexcept
 {
     return this->deviceManager;
@@ -132,13 +158,48 @@ void AudioCore::removeInstrument(Instrument *instrument)
 
 void AudioCore::addInstrumentToDevice(Instrument *instrument)
 {
-    this->deviceManager.addAudioCallback(&instrument->getProcessorPlayer());
+    auto job = new InstrumentJob();
+    job->instrument = instrument;
+
+    // just like AudioDeviceManager::addAudioCallback does
+    if (AudioIODevice *device = this->deviceManager.getCurrentAudioDevice())
+    {
+        instrument->getProcessorPlayer().audioDeviceAboutToStart(device);
+        job->buffer.setSize(device->getActiveOutputChannels().countNumberOfSetBits(),
+                            device->getCurrentBufferSizeSamples());
+    }
+
+    {
+        const ScopedLock sl(this->deviceManager.getAudioCallbackLock());
+        this->instrumentJobs.add(job);
+        this->busyJobs.ensureStorageAllocated(this->instrumentJobs.size());
+    }
+
     this->deviceManager.addMidiInputCallback(String::empty, &instrument->getProcessorPlayer().getMidiMessageCollector());
 }
 
 void AudioCore::removeInstrumentFromDevice(Instrument *instrument)
 {
-    this->deviceManager.removeAudioCallback(&instrument->getProcessorPlayer());
+    ScopedPointer<InstrumentJob> removedJob;
+
+    {
+        const ScopedLock sl(this->deviceManager.getAudioCallbackLock());
+
+        for (int i = 0; i < this->instrumentJobs.size(); ++i)
+        {
+            if (this->instrumentJobs.getUnchecked(i)->instrument == instrument)
+            {
+                removedJob = this->instrumentJobs.removeAndReturn(i);
+                break;
+            }
+        }
+    }
+
+    if (removedJob != nullptr)
+    {
+        instrument->getProcessorPlayer().audioDeviceStopped();
+    }
+
     this->deviceManager.removeMidiInputCallback(String::empty, &instrument->getProcessorPlayer().getMidiMessageCollector());
 }
 
@@ -223,6 +284,115 @@ void AudioCore::autodetect()
     }
 }
 
+//===----------------------------------------------------------------------===//
+// AudioIODeviceCallback
+//===----------------------------------------------------------------------===//
+
+void AudioCore::audioDeviceIOCallback(const float **inputChannelData,
+                                      int numInputChannels,
+                                      float **outputChannelData,
+                                      int numOutputChannels,
+                                      int numSamples)
+{
+    if (this->playbackScheduler != nullptr)
+    {
+        this->playbackScheduler->processNextBlock(numSamples, this->sampleRate);
+    }
+
+    this->currentInputChannelData = inputChannelData;
+    this->currentNumInputChannels = numInputChannels;
+    this->currentNumOutputChannels = numOutputChannels;
+    this->currentNumSamples = numSamples;
+
+    // idle instruments, which have no input and were silent in the last block,
+    // are processed right here, and only the busy ones are shared with the workers
+    this->busyJobs.clearQuick();
+
+    for (auto job : this->instrumentJobs)
+    {
+        // never reallocates, unless the device has changed its block size
+        job->buffer.setSize(numOutputChannels, numSamples, false, false, true);
+
+        if (job->isSilent && job->instrument->getScheduledMidi().isEmpty())
+        {
+            this->processInstrumentJob(*job);
+        }
+        else
+        {
+            this->busyJobs.add(job);
+        }
+    }
+
+    this->workerPool->processJobs(*this, this->busyJobs.size());
+
+    for (int channel = 0; channel < numOutputChannels; ++channel)
+    {
+        if (float *output = outputChannelData[channel])
+        {
+            FloatVectorOperations::clear(output, numSamples);
+
+            for (auto job : this->instrumentJobs)
+            {
+                FloatVectorOperations::add(output, job->buffer.getReadPointer(channel), numSamples);
+            }
+        }
+    }
+
+    for (auto job : this->instrumentJobs)
+    {
+        job->isSilent = (job->buffer.getMagnitude(0, numSamples) < AUDIO_CORE_SILENCE_LEVEL);
+    }
+
+    this->audioMonitor->audioDeviceIOCallback(inputChannelData, numInputChannels,
+                                              outputChannelData, numOutputChannels,
+                                              numSamples);
+}
+
+void AudioCore::audioDeviceAboutToStart(AudioIODevice *device)
+{
+    this->sampleRate = device->getCurrentSampleRate();
+
+    for (auto job : this->instrumentJobs)
+    {
+        job->instrument->getProcessorPlayer().audioDeviceAboutToStart(device);
+        job->buffer.setSize(device->getActiveOutputChannels().countNumberOfSetBits(),
+                            device->getCurrentBufferSizeSamples());
+    }
+
+    this->audioMonitor->audioDeviceAboutToStart(device);
+}
+
+void AudioCore::audioDeviceStopped()
+{
+    for (auto job : this->instrumentJobs)
+    {
+        job->instrument->getProcessorPlayer().audioDeviceStopped();
+    }
+
+    this->audioMonitor->audioDeviceStopped();
+}
+
+//===----------------------------------------------------------------------===//
+// AudioWorkerPool::Client
+//===----------------------------------------------------------------------===//
+
+void AudioCore::processJob(int jobIndex)
+{
+    this->processInstrumentJob(*this->busyJobs.getUnchecked(jobIndex));
+}
+
+void AudioCore::processInstrumentJob(InstrumentJob &job)
+{
+    // each player has its own lock and its own midi collector,
+    // so different instruments are safe to process concurrently
+    job.instrument->getProcessorPlayer().audioDeviceIOCallback(this->currentInputChannelData,
+                                                               this->currentNumInputChannels,
+                                                               job.buffer.getArrayOfWritePointers(),
+                                                               this->currentNumOutputChannels,
+                                                               this->currentNumSamples);
+}
+
+
 //===----------------------------------------------------------------------===//
 // Serializable
 //===----------------------------------------------------------------------===//
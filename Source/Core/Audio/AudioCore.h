@@ -19,14 +19,18 @@
 
 class Instrument;
 class AudioMonitor;
+class PlaybackScheduler;
 
 #include "Serializable.h"
 #include "OrchestraPit.h"
+#include "AudioWorkerPool.h"
 
 class AudioCore :
     public Serializable,
     public ChangeBroadcaster,
-    public OrchestraPit
+    public OrchestraPit,
+    private AudioIODeviceCallback,
+    private AudioWorkerPool::Client
 {
 public:
 
@@ -62,6 +66,14 @@ public:
     AudioPluginFormatManager &getFormatManager() noexcept;
     AudioMonitor *getMonitor() const noexcept;
 
+    // The scheduler is called before every block, prior to instruments,
+    // so that it could fill their MIDI buffers for that block
+    void setPlaybackScheduler(PlaybackScheduler *scheduler);
+
+    // Instruments are processed in parallel by a helper thread per core,
+    // except for the audio thread's own one
+    int getNumAudioWorkers() const noexcept;
+
     //===------------------------------------------------------------------===//
     // Serializable
     //===------------------------------------------------------------------===//
@@ -115,12 +127,59 @@ public:
     
 private:
 
+    //===------------------------------------------------------------------===//
+    // AudioIODeviceCallback
+    //===------------------------------------------------------------------===//
+
+    void audioDeviceIOCallback(const float **inputChannelData,
+                               int numInputChannels,
+                               float **outputChannelData,
+                               int numOutputChannels,
+                               int numSamples) override;
+
+    void audioDeviceAboutToStart(AudioIODevice *device) override;
+    void audioDeviceStopped() override;
+
+    //===------------------------------------------------------------------===//
+    // AudioWorkerPool::Client
+    //===------------------------------------------------------------------===//
+
+    void processJob(int jobIndex) override;
+
+    struct InstrumentJob;
+    void processInstrumentJob(InstrumentJob &job);
+
     void addInstrumentToDevice(Instrument *instrument);
     void removeInstrumentFromDevice(Instrument *instrument);
 
     OwnedArray<Instrument> instruments;
     ScopedPointer<AudioMonitor> audioMonitor;
 
+    PlaybackScheduler *playbackScheduler;
+    double sampleRate;
+
+    // All instruments are rendered by our single device callback
+    // into their own buffers, and then mixed into the output;
+    // the list is guarded by the device's audio callback lock
+    struct InstrumentJob
+    {
+        InstrumentJob() : instrument(nullptr), isSilent(false) {}
+        Instrument *instrument;
+        AudioSampleBuffer buffer;
+        bool isSilent;
+    };
+
+    OwnedArray<InstrumentJob> instrumentJobs;
+
+    // The jobs shared with the workers in the current block
+    Array<InstrumentJob *> busyJobs;
+    ScopedPointer<AudioWorkerPool> workerPool;
+
+    const float **currentInputChannelData;
+    int currentNumInputChannels;
+    int currentNumOutputChannels;
+    int currentNumSamples;
+
     AudioPluginFormatManager formatManager;
     AudioDeviceManager deviceManager;
     
@@ -0,0 +1,330 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "AudioWorkerPool.h"
+
+#if JUCE_WINDOWS
+#   ifndef NOMINMAX
+#       define NOMINMAX
+#   endif
+#   include <windows.h>
+#elif JUCE_MAC || JUCE_IOS
+#   include <dispatch/dispatch.h>
+#else
+#   include <semaphore.h>
+#   include <errno.h>
+#endif
+
+#define AUDIO_WORKER_STOP_TIME_MS 500
+
+// Idle workers keep polling for about one block period after their last job,
+// so that they don't park between blocks, but never longer than this
+#define AUDIO_WORKER_MAX_SPIN_TIME_MS 20
+
+// Waking up a parked worker and handing it a job takes a few dozen microseconds,
+// so blocks which are faster than that are processed serially
+#define AUDIO_WORKER_MIN_SHARED_WORK_TIME_MS 0.1
+
+// The jobs state is packed as [generation:32][numJobs:16][nextJobIndex:16]
+#define AUDIO_WORKER_MAX_JOBS 0xffff
+
+static inline int64 packJobsState(uint32 generation, int numJobs, int nextJobIndex) noexcept
+{
+    return int64((uint64(generation) << 32) | (uint64(numJobs) << 16) | uint64(nextJobIndex));
+}
+
+static inline uint32 getGeneration(int64 state) noexcept
+{
+    return uint32(uint64(state) >> 32);
+}
+
+static inline int getNumJobs(int64 state) noexcept
+{
+    return int((uint64(state) >> 16) & AUDIO_WORKER_MAX_JOBS);
+}
+
+static inline int getNextJobIndex(int64 state) noexcept
+{
+    return int(uint64(state) & AUDIO_WORKER_MAX_JOBS);
+}
+
+//===----------------------------------------------------------------------===//
+// Semaphore
+//===----------------------------------------------------------------------===//
+
+// Unlike WaitableEvent, posting it takes no mutex, and only enters
+// the kernel when there is a waiting thread to wake up
+class AudioWorkerPool::Semaphore
+{
+public:
+
+#if JUCE_WINDOWS
+
+    Semaphore() : handle(CreateSemaphore(nullptr, 0, LONG_MAX, nullptr)) {}
+    ~Semaphore() { CloseHandle(this->handle); }
+
+    void post(int count) noexcept
+    { ReleaseSemaphore(this->handle, count, nullptr); }
+
+    void wait() noexcept
+    { WaitForSingleObject(this->handle, INFINITE); }
+
+private:
+
+    HANDLE handle;
+
+#elif JUCE_MAC || JUCE_IOS
+
+    Semaphore() : semaphore(dispatch_semaphore_create(0)) {}
+    ~Semaphore() { dispatch_release(this->semaphore); }
+
+    void post(int count) noexcept
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            dispatch_semaphore_signal(this->semaphore);
+        }
+    }
+
+    void wait() noexcept
+    { dispatch_semaphore_wait(this->semaphore, DISPATCH_TIME_FOREVER); }
+
+private:
+
+    dispatch_semaphore_t semaphore;
+
+#else
+
+    Semaphore() { sem_init(&this->semaphore, 0, 0); }
+    ~Semaphore() { sem_destroy(&this->semaphore); }
+
+    void post(int count) noexcept
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            sem_post(&this->semaphore);
+        }
+    }
+
+    void wait() noexcept
+    {
+        while (sem_wait(&this->semaphore) != 0 && errno == EINTR) {}
+    }
+
+private:
+
+    sem_t semaphore;
+
+#endif
+
+    JUCE_DECLARE_NON_COPYABLE(Semaphore)
+};
+
+//===----------------------------------------------------------------------===//
+// Worker
+//===----------------------------------------------------------------------===//
+
+class AudioWorkerPool::Worker : public Thread
+{
+public:
+
+    explicit Worker(AudioWorkerPool &parentPool) :
+        Thread("AudioWorker"),
+        pool(parentPool) {}
+
+    void run() override
+    {
+        int64 lastJobTime = Time::getHighResolutionTicks();
+
+        while (! this->threadShouldExit())
+        {
+            if (this->pool.processNextJob())
+            {
+                while (this->pool.processNextJob()) {}
+                lastJobTime = Time::getHighResolutionTicks();
+            }
+            else if (Time::getHighResolutionTicks() - lastJobTime < this->pool.spinTime.get())
+            {
+                Thread::yield();
+            }
+            else
+            {
+                this->pool.parkWorker();
+                lastJobTime = Time::getHighResolutionTicks();
+            }
+        }
+    }
+
+private:
+
+    AudioWorkerPool &pool;
+
+    JUCE_DECLARE_NON_COPYABLE(Worker)
+};
+
+//===----------------------------------------------------------------------===//
+// AudioWorkerPool
+//===----------------------------------------------------------------------===//
+
+AudioWorkerPool::AudioWorkerPool(int numWorkers, int workerPriority) :
+    wakeUpSemaphore(new Semaphore()),
+    numParkedWorkers(0),
+    currentClient(nullptr),
+    jobsState(packJobsState(0, 0, 0)),
+    numJobsDone(0),
+    blockWorkTime(0),
+    lastBlockWorkTime(0),
+    minSharedWorkTime(Time::secondsToHighResolutionTicks(AUDIO_WORKER_MIN_SHARED_WORK_TIME_MS / 1000.0)),
+    spinTime(0),
+    lastBlockStartTime(0),
+    maxSpinTime(Time::secondsToHighResolutionTicks(AUDIO_WORKER_MAX_SPIN_TIME_MS / 1000.0))
+{
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        Worker *worker = this->workers.add(new Worker(*this));
+        worker->startThread(workerPriority);
+    }
+}
+
+AudioWorkerPool::~AudioWorkerPool()
+{
+    for (auto worker : this->workers)
+    {
+        worker->signalThreadShouldExit();
+    }
+
+    // each worker parks at most once more before it sees the exit flag
+    this->wakeUpSemaphore->post(this->workers.size());
+
+    for (auto worker : this->workers)
+    {
+        worker->stopThread(AUDIO_WORKER_STOP_TIME_MS);
+    }
+}
+
+int AudioWorkerPool::getNumWorkers() const noexcept
+{
+    return this->workers.size();
+}
+
+int AudioWorkerPool::getDefaultNumWorkers()
+{
+    // the audio thread itself takes jobs too
+    return jmax(0, SystemStats::getNumCpus() - 1);
+}
+
+void AudioWorkerPool::processJobs(Client &client, int numJobs)
+{
+    jassert(numJobs <= AUDIO_WORKER_MAX_JOBS);
+
+    const int64 blockStartTime = Time::getHighResolutionTicks();
+
+    if (this->lastBlockStartTime != 0)
+    {
+        this->spinTime = jmin(blockStartTime - this->lastBlockStartTime, this->maxSpinTime);
+    }
+
+    this->lastBlockStartTime = blockStartTime;
+
+    // not worth sharing
+    if (this->workers.size() == 0 || numJobs < 2 || this->lastBlockWorkTime < this->minSharedWorkTime)
+    {
+        for (int i = 0; i < numJobs; ++i)
+        {
+            client.processJob(i);
+        }
+
+        this->lastBlockWorkTime = Time::getHighResolutionTicks() - blockStartTime;
+        return;
+    }
+
+    // the previous block is complete at this point, so nobody reads these;
+    // the new state is published last, and it makes them visible
+    this->currentClient = &client;
+    this->numJobsDone = 0;
+    this->blockWorkTime = 0;
+
+    const uint32 generation = getGeneration(this->jobsState.get()) + 1;
+    this->jobsState = packJobsState(generation, numJobs, 0);
+
+    // the workers which are still polling will see the new state themselves,
+    // and there's no use in waking up more of them than there are jobs to share
+    for (int numParked = this->numParkedWorkers.get(); numParked > 0; numParked = this->numParkedWorkers.get())
+    {
+        const int numToWakeUp = jmin(numParked, numJobs - 1);
+
+        if (this->numParkedWorkers.compareAndSetBool(numParked - numToWakeUp, numParked))
+        {
+            this->wakeUpSemaphore->post(numToWakeUp);
+            break;
+        }
+    }
+
+    while (this->processNextJob()) {}
+
+    // only waiting for the jobs already taken by the workers
+    while (this->numJobsDone.get() < numJobs)
+    {
+        Thread::yield();
+    }
+
+    this->lastBlockWorkTime = this->blockWorkTime.get();
+}
+
+bool AudioWorkerPool::processNextJob()
+{
+    const int64 state = this->jobsState.get();
+    const int jobIndex = getNextJobIndex(state);
+
+    if (jobIndex >= getNumJobs(state))
+    { return false; }
+
+    Client *client = this->currentClient.get();
+
+    // fails if the job is taken by another thread, which means trying the next one;
+    // succeeds only if the block of this state is still not complete,
+    // so the client read above belongs to it
+    if (this->jobsState.compareAndSetBool(packJobsState(getGeneration(state), getNumJobs(state), jobIndex + 1), state))
+    {
+        const int64 jobStartTime = Time::getHighResolutionTicks();
+        client->processJob(jobIndex);
+        this->blockWorkTime += Time::getHighResolutionTicks() - jobStartTime;
+        ++this->numJobsDone;
+    }
+
+    return true;
+}
+
+bool AudioWorkerPool::hasPendingJobs() const noexcept
+{
+    const int64 state = this->jobsState.get();
+    return getNextJobIndex(state) < getNumJobs(state);
+}
+
+void AudioWorkerPool::parkWorker()
+{
+    ++this->numParkedWorkers;
+
+    // a block published right before the worker got counted won't wake it up,
+    // so it checks the state once again; if it is woken up by the next block
+    // while not waiting, its next park will just return at once
+    if (! this->hasPendingJobs())
+    {
+        this->wakeUpSemaphore->wait();
+    }
+}
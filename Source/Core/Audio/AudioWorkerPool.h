@@ -0,0 +1,85 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// A set of pre-spawned threads, which help the calling thread
+// to process independent jobs within a single audio block.
+// Each block is published as a single atomic state of its generation,
+// job count and next job index, and jobs are claimed by compare-and-swap,
+// so a worker which wakes up late can't take a job from another block.
+// The calling thread also takes jobs, and returns as soon as all of them
+// are done, without waiting for the workers to wake up or check in.
+// Workers keep polling the state for about one block period after their
+// last job, and then park on a semaphore, which the calling thread only
+// posts when some of them are counted as parked.
+// Blocks which took too little time to be worth sharing last time,
+// or have less than two jobs, are processed serially by the caller.
+
+class AudioWorkerPool
+{
+public:
+
+    class Client
+    {
+    public:
+        virtual ~Client() {}
+        virtual void processJob(int jobIndex) = 0;
+    };
+
+    // Workers should run at the priority of the calling thread,
+    // so that the caller never waits for a preempted job
+    AudioWorkerPool(int numWorkers, int workerPriority);
+    ~AudioWorkerPool();
+
+    int getNumWorkers() const noexcept;
+
+    // Audio thread
+    void processJobs(Client &client, int numJobs);
+
+    static int getDefaultNumWorkers();
+
+private:
+
+    class Worker;
+    OwnedArray<Worker> workers;
+
+    class Semaphore;
+    ScopedPointer<Semaphore> wakeUpSemaphore;
+    Atomic<int> numParkedWorkers;
+
+    Atomic<Client *> currentClient;
+    Atomic<int64> jobsState;
+    Atomic<int> numJobsDone;
+
+    // Time spent in jobs, summed over all threads
+    Atomic<int64> blockWorkTime;
+    int64 lastBlockWorkTime;
+    const int64 minSharedWorkTime;
+
+    // How long idle workers keep polling, about one block period
+    Atomic<int64> spinTime;
+    int64 lastBlockStartTime;
+    const int64 maxSpinTime;
+
+    // Returns false when there are no jobs left in the current block
+    bool processNextJob();
+    bool hasPendingJobs() const noexcept;
+    void parkWorker();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioWorkerPool)
+};
@@ -24,13 +24,44 @@
 
 const int Instrument::midiChannelNumber = 0x1000;
 
+// Merges the events scheduled by the transport into every realtime block
+class InstrumentGraph final : public AudioProcessorGraph
+{
+public:
+
+    explicit InstrumentGraph(MidiBuffer &scheduledMidiRef) :
+        scheduledMidi(scheduledMidiRef) {}
+
+    using AudioProcessorGraph::processBlock;
+
+    void processBlock(AudioBuffer<float> &buffer, MidiBuffer &midiMessages) override
+    {
+        // the renderer provides its own events
+        if (! this->isNonRealtime() && ! this->scheduledMidi.isEmpty())
+        {
+            midiMessages.addEvents(this->scheduledMidi, 0, buffer.getNumSamples(), 0);
+            this->scheduledMidi.clear();
+        }
+
+        AudioProcessorGraph::processBlock(buffer, midiMessages);
+    }
+
+private:
+
+    MidiBuffer &scheduledMidi;
+
+    JUCE_DECLARE_NON_COPYABLE(InstrumentGraph)
+};
+
 Instrument::Instrument(AudioPluginFormatManager &formatManager, String name) :
     formatManager(formatManager),
     instrumentName(std::move(name)),
     lastUID(0),
     instrumentID()
 {
-    this->processorGraph = new AudioProcessorGraph();
+    // reserved once, as the buffer is only filled from the audio thread
+    this->scheduledMidi.ensureSize(2048);
+    this->processorGraph = new InstrumentGraph(this->scheduledMidi);
     this->initializeDefaultNodes();
     this->processorPlayer.setProcessor(this->processorGraph);
 }
@@ -97,35 +128,69 @@ void Instrument::initializeFrom(const PluginDescription &pluginDescription)
     this->processorGraph->clear();
     this->initializeDefaultNodes();
     
-    this->addNodeAsync(pluginDescription, 0.5f, 0.5f, [&](AudioProcessorGraph::Node *instrument)
+    this->addNodeAsync(pluginDescription, 0.5f, 0.5f, [this](AudioProcessorGraph::Node *instrument)
                        {
                            if (instrument == nullptr) { return; }
                            
-                           // ограничить 2мя?
-                           for (int i = 0; i < instrument->getProcessor()->getTotalNumInputChannels(); ++i)
-                           {
-                               this->addConnection(this->audioIn->nodeId, i, instrument->nodeId, i);
-                           }
-                           
-                           if (instrument->getProcessor()->acceptsMidi())
-                           {
-                               this->addConnection(this->midiIn->nodeId, Instrument::midiChannelNumber, instrument->nodeId, Instrument::midiChannelNumber);
-                           }
-                           
-                           for (int i = 0; i < instrument->getProcessor()->getTotalNumOutputChannels(); ++i)
-                           {
-                               this->addConnection(instrument->nodeId, i, this->audioOut->nodeId, i);
-                           }
-                           
-                           if (instrument->getProcessor()->producesMidi())
-                           {
-                               this->addConnection(instrument->nodeId, Instrument::midiChannelNumber, this->midiOut->nodeId, Instrument::midiChannelNumber);
-                           }
-                           
+                           this->connectToDefaultNodes(instrument);
                            this->sendChangeMessage();
                        });
 }
 
+bool Instrument::initializeSynchronouslyFrom(const PluginDescription &pluginDescription)
+{
+    this->processorGraph->clear();
+    this->initializeDefaultNodes();
+    
+    String errorMessage;
+    
+    AudioPluginInstance *instance =
+        this->formatManager.createPluginInstance(pluginDescription,
+                                                 this->processorGraph->getSampleRate(),
+                                                 this->processorGraph->getBlockSize(),
+                                                 errorMessage);
+    
+    if (instance == nullptr)
+    {
+        return false;
+    }
+    
+    AudioProcessorGraph::Node *node = this->processorGraph->addNode(instance);
+    
+    if (node == nullptr)
+    {
+        return false;
+    }
+    
+    this->configureNode(node, pluginDescription, 0.5f, 0.5f);
+    this->connectToDefaultNodes(node);
+    return true;
+}
+
+void Instrument::connectToDefaultNodes(AudioProcessorGraph::Node *instrument)
+{
+    // ограничить 2мя?
+    for (int i = 0; i < instrument->getProcessor()->getTotalNumInputChannels(); ++i)
+    {
+        this->addConnection(this->audioIn->nodeId, i, instrument->nodeId, i);
+    }
+    
+    if (instrument->getProcessor()->acceptsMidi())
+    {
+        this->addConnection(this->midiIn->nodeId, Instrument::midiChannelNumber, instrument->nodeId, Instrument::midiChannelNumber);
+    }
+    
+    for (int i = 0; i < instrument->getProcessor()->getTotalNumOutputChannels(); ++i)
+    {
+        this->addConnection(instrument->nodeId, i, this->audioOut->nodeId, i);
+    }
+    
+    if (instrument->getProcessor()->producesMidi())
+    {
+        this->addConnection(instrument->nodeId, Instrument::midiChannelNumber, this->midiOut->nodeId, Instrument::midiChannelNumber);
+    }
+}
+
 void Instrument::addNodeToFreeSpace(const PluginDescription &pluginDescription)
 {
     // TODO: calc free space
@@ -141,6 +206,36 @@ void Instrument::addNodeToFreeSpace(const PluginDescription &pluginDescription)
     });
 }
 
+Instrument *Instrument::createCopy() const
+{
+    ScopedPointer<XmlElement> xml(this->serialize());
+    ScopedPointer<Instrument> copy(new Instrument(this->formatManager, this->instrumentName));
+
+    copy->processorGraph->setPlayConfigDetails(this->processorGraph->getTotalNumInputChannels(),
+                                               this->processorGraph->getTotalNumOutputChannels(),
+                                               this->processorGraph->getSampleRate(),
+                                               this->processorGraph->getBlockSize());
+
+    copy->processorGraph->clear();
+
+    // unlike deserialize(), nodes are created synchronously here
+    forEachXmlChildElementWithTagName(*xml, e, Serialization::Core::instrumentNode)
+    {
+        copy->createNodeFromXml(*e);
+    }
+
+    forEachXmlChildElementWithTagName(*xml, e, Serialization::Core::instrumentConnection)
+    {
+        copy->addConnection(static_cast<uint32>(e->getIntAttribute("srcFilter")),
+                            e->getIntAttribute("srcChannel"),
+                            static_cast<uint32>(e->getIntAttribute("dstFilter")),
+                            e->getIntAttribute("dstChannel"));
+    }
+
+    copy->processorGraph->removeIllegalConnections();
+    return copy.release();
+}
+
 
 uint32 Instrument::getNextUID() noexcept
 {
@@ -43,6 +43,14 @@ public:
     void initializeFrom(const PluginDescription &pluginDescription);
     void addNodeToFreeSpace(const PluginDescription &pluginDescription);
 
+    // Blocks until the plugin is created; used in a command-line mode,
+    // where the message loop is not spinning yet
+    bool initializeSynchronouslyFrom(const PluginDescription &pluginDescription);
+
+    // Another instance with the same nodes and plugin states,
+    // not connected to the device; used in offline rendering
+    Instrument *createCopy() const;
+
 
     // gets connected to the audiocore's device
     AudioProcessorPlayer &getProcessorPlayer() noexcept
@@ -51,6 +59,11 @@ public:
     AudioProcessorGraph *getProcessorGraph() noexcept
     { return this->processorGraph; }
 
+    // Sample-accurate events for the next block processed in realtime;
+    // only accessed from the audio thread, see PlaybackScheduler
+    MidiBuffer &getScheduledMidi() noexcept
+    { return this->scheduledMidi; }
+
 
 
 
@@ -160,6 +173,8 @@ private:
 
     void configureNode(AudioProcessorGraph::Node *, const PluginDescription &, double x, double y);
 
+    void connectToDefaultNodes(AudioProcessorGraph::Node *instrument);
+
     friend class Transport;
 
     friend class AudioCore;
@@ -170,6 +185,8 @@ private:
 
     AudioProcessorPlayer processorPlayer;
 
+    MidiBuffer scheduledMidi;
+
     ScopedPointer<AudioProcessorGraph> processorGraph;
 
 
@@ -0,0 +1,246 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "LoudnessMeter.h"
+
+#define LOUDNESS_ABSOLUTE_GATE -70.0
+#define LOUDNESS_RELATIVE_GATE -10.0
+
+static double energyToLoudness(double energy)
+{
+    return -0.691 + 10.0 * log10(energy);
+}
+
+static double loudnessToEnergy(double loudness)
+{
+    return pow(10.0, (loudness + 0.691) / 10.0);
+}
+
+LoudnessMeter::LoudnessMeter() :
+    numChannels(0),
+    historyIndex(0),
+    samplePeak(0.f),
+    truePeak(0.f),
+    samplesPerStep(0),
+    samplesInStep(0),
+    stepEnergy(0.0),
+    numSteps(0)
+{
+    // windowed sinc, split into polyphase components
+    const int numTaps = TRUE_PEAK_OVERSAMPLING * TRUE_PEAK_TAPS_PER_PHASE;
+    const double centre = (numTaps - 1) * 0.5;
+
+    for (int phase = 0; phase < TRUE_PEAK_OVERSAMPLING; ++phase)
+    {
+        double sum = 0.0;
+
+        for (int j = 0; j < TRUE_PEAK_TAPS_PER_PHASE; ++j)
+        {
+            const int tap = j * TRUE_PEAK_OVERSAMPLING + phase;
+            const double t = (tap - centre) / TRUE_PEAK_OVERSAMPLING;
+            const double sinc = (t == 0.0) ? 1.0 : sin(double_Pi * t) / (double_Pi * t);
+            const double window = 0.5 - 0.5 * cos(2.0 * double_Pi * (tap + 0.5) / numTaps);
+            this->interpolator[phase][j] = float(sinc * window);
+            sum += sinc * window;
+        }
+
+        for (int j = 0; j < TRUE_PEAK_TAPS_PER_PHASE; ++j)
+        {
+            this->interpolator[phase][j] = float(this->interpolator[phase][j] / sum);
+        }
+    }
+
+    zerostruct(this->kWeighting);
+    zerostruct(this->channels);
+    zerostruct(this->lastSteps);
+}
+
+void LoudnessMeter::reset(double sampleRate, int numInputChannels)
+{
+    // K-weighting filter coefficients for any sample rate,
+    // a high shelf followed by a high pass, as in libebur128
+    {
+        const double f0 = 1681.974450955533;
+        const double gain = 3.999843853973347;
+        const double q = 0.7071752369554196;
+        const double k = tan(double_Pi * f0 / sampleRate);
+        const double vh = pow(10.0, gain / 20.0);
+        const double vb = pow(vh, 0.4996667741545416);
+        const double a0 = 1.0 + k / q + k * k;
+
+        Biquad &shelf = this->kWeighting[0];
+        shelf.b0 = (vh + vb * k / q + k * k) / a0;
+        shelf.b1 = 2.0 * (k * k - vh) / a0;
+        shelf.b2 = (vh - vb * k / q + k * k) / a0;
+        shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+        shelf.a2 = (1.0 - k / q + k * k) / a0;
+    }
+
+    {
+        const double f0 = 38.13547087602444;
+        const double q = 0.5003270373238773;
+        const double k = tan(double_Pi * f0 / sampleRate);
+        const double a0 = 1.0 + k / q + k * k;
+
+        Biquad &highPass = this->kWeighting[1];
+        highPass.b0 = 1.0;
+        highPass.b1 = -2.0;
+        highPass.b2 = 1.0;
+        highPass.a1 = 2.0 * (k * k - 1.0) / a0;
+        highPass.a2 = (1.0 - k / q + k * k) / a0;
+    }
+
+    zerostruct(this->channels);
+    zerostruct(this->lastSteps);
+
+    this->numChannels = jmin(numInputChannels, LOUDNESS_METER_MAX_CHANNELS);
+    this->historyIndex = 0;
+    this->samplePeak = 0.f;
+    this->truePeak = 0.f;
+    this->samplesPerStep = jmax(1, roundToInt(sampleRate / 10.0));
+    this->samplesInStep = 0;
+    this->stepEnergy = 0.0;
+    this->numSteps = 0;
+    this->blockEnergies.clearQuick();
+}
+
+void LoudnessMeter::process(const AudioSampleBuffer &buffer, int numSamples)
+{
+    const int numInputChannels = jmin(this->numChannels, buffer.getNumChannels());
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        for (int c = 0; c < numInputChannels; ++c)
+        {
+            const float sample = buffer.getSample(c, i);
+            ChannelState &state = this->channels[c];
+
+            this->samplePeak = jmax(this->samplePeak, std::abs(sample));
+
+            // inter-sample peaks
+            state.history[this->historyIndex] = sample;
+
+            for (int phase = 0; phase < TRUE_PEAK_OVERSAMPLING; ++phase)
+            {
+                float interpolated = 0.f;
+
+                for (int j = 0; j < TRUE_PEAK_TAPS_PER_PHASE; ++j)
+                {
+                    const int h = (this->historyIndex - j + TRUE_PEAK_TAPS_PER_PHASE) % TRUE_PEAK_TAPS_PER_PHASE;
+                    interpolated += this->interpolator[phase][j] * state.history[h];
+                }
+
+                this->truePeak = jmax(this->truePeak, std::abs(interpolated));
+            }
+
+            // K-weighted energy, transposed direct form II
+            double weighted = sample;
+
+            for (int f = 0; f < 2; ++f)
+            {
+                const Biquad &filter = this->kWeighting[f];
+                const double out = filter.b0 * weighted + state.z1[f];
+                state.z1[f] = filter.b1 * weighted - filter.a1 * out + state.z2[f];
+                state.z2[f] = filter.b2 * weighted - filter.a2 * out;
+                weighted = out;
+            }
+
+            this->stepEnergy += weighted * weighted;
+        }
+
+        this->historyIndex = (this->historyIndex + 1) % TRUE_PEAK_TAPS_PER_PHASE;
+
+        if (++this->samplesInStep == this->samplesPerStep)
+        {
+            this->finishStep();
+        }
+    }
+}
+
+void LoudnessMeter::finishStep()
+{
+    this->lastSteps[this->numSteps % 4] = this->stepEnergy;
+    this->numSteps++;
+
+    if (this->numSteps >= 4)
+    {
+        const double blockEnergy =
+            (this->lastSteps[0] + this->lastSteps[1] + this->lastSteps[2] + this->lastSteps[3]) /
+            (4.0 * this->samplesPerStep);
+
+        this->blockEnergies.add(blockEnergy);
+    }
+
+    this->stepEnergy = 0.0;
+    this->samplesInStep = 0;
+}
+
+float LoudnessMeter::getSamplePeak() const noexcept
+{
+    return Decibels::gainToDecibels(this->samplePeak, LOUDNESS_MINUS_INFINITY);
+}
+
+float LoudnessMeter::getTruePeak() const noexcept
+{
+    // the interpolated peak can never be lower than the sample peak
+    return Decibels::gainToDecibels(jmax(this->samplePeak, this->truePeak), LOUDNESS_MINUS_INFINITY);
+}
+
+float LoudnessMeter::getIntegratedLoudness() const
+{
+    const double absoluteGate = loudnessToEnergy(LOUDNESS_ABSOLUTE_GATE);
+
+    double sum = 0.0;
+    int numBlocks = 0;
+
+    for (const auto energy : this->blockEnergies)
+    {
+        if (energy > absoluteGate)
+        {
+            sum += energy;
+            numBlocks++;
+        }
+    }
+
+    if (numBlocks == 0)
+    {
+        return LOUDNESS_MINUS_INFINITY;
+    }
+
+    const double relativeGate = (sum / numBlocks) * pow(10.0, LOUDNESS_RELATIVE_GATE / 10.0);
+    const double gate = jmax(absoluteGate, relativeGate);
+
+    sum = 0.0;
+    numBlocks = 0;
+
+    for (const auto energy : this->blockEnergies)
+    {
+        if (energy > gate)
+        {
+            sum += energy;
+            numBlocks++;
+        }
+    }
+
+    if (numBlocks == 0)
+    {
+        return LOUDNESS_MINUS_INFINITY;
+    }
+
+    return float(jmax(double(LOUDNESS_MINUS_INFINITY), energyToLoudness(sum / numBlocks)));
+}
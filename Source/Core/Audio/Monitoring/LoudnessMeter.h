@@ -0,0 +1,78 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#define TRUE_PEAK_OVERSAMPLING 4
+#define TRUE_PEAK_TAPS_PER_PHASE 12
+#define LOUDNESS_METER_MAX_CHANNELS 2
+#define LOUDNESS_MINUS_INFINITY -100.f
+
+// Offline meter for the rendered mix, as in ITU-R BS.1770:
+// integrated loudness over gated 400 ms blocks of K-weighted signal,
+// and true peak estimated with 4x polyphase oversampling.
+
+class LoudnessMeter
+{
+public:
+
+    LoudnessMeter();
+
+    void reset(double sampleRate, int numChannels);
+    void process(const AudioSampleBuffer &buffer, int numSamples);
+
+    float getSamplePeak() const noexcept; // dBFS
+    float getTruePeak() const noexcept; // dBTP
+    float getIntegratedLoudness() const; // LUFS
+
+private:
+
+    struct Biquad
+    {
+        double b0, b1, b2, a1, a2;
+    };
+
+    struct ChannelState
+    {
+        double z1[2];
+        double z2[2];
+        float history[TRUE_PEAK_TAPS_PER_PHASE];
+    };
+
+    Biquad kWeighting[2];
+    ChannelState channels[LOUDNESS_METER_MAX_CHANNELS];
+    float interpolator[TRUE_PEAK_OVERSAMPLING][TRUE_PEAK_TAPS_PER_PHASE];
+
+    int numChannels;
+    int historyIndex;
+
+    float samplePeak;
+    float truePeak;
+
+    // 100 ms steps, every four of them make a block with 75% overlap
+    int samplesPerStep;
+    int samplesInStep;
+    double stepEnergy;
+    double lastSteps[4];
+    int numSteps;
+
+    Array<double> blockEnergies;
+
+    void finishStep();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LoudnessMeter)
+};
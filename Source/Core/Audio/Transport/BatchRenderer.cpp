@@ -0,0 +1,456 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "BatchRenderer.h"
+#include "Transport.h"
+#include "OrchestraPit.h"
+#include "Instrument.h"
+#include "AudioCore.h"
+#include "BuiltInSynthFormat.h"
+#include "MidiTrack.h"
+#include "PianoSequence.h"
+#include "AutomationSequence.h"
+#include "Pattern.h"
+#include "ProjectTreeItem.h"
+#include "ProjectEventDispatcher.h"
+#include "TreeItem.h"
+#include "DataEncoder.h"
+#include "ChunkedProjectFile.h"
+#include "SerializationKeys.h"
+
+#define BATCH_RENDER_FLAG "--render"
+#define BATCH_RENDER_DEFAULT_FORMAT "wav"
+#define BATCH_RENDER_DEFAULT_SAMPLE_RATE 44100.0
+#define BATCH_RENDER_BLOCK_SIZE 512
+#define BATCH_RENDER_UPDATE_TIME_MS 100
+
+//===----------------------------------------------------------------------===//
+// A track without a tree item, which just keeps its properties
+//===----------------------------------------------------------------------===//
+
+class HeadlessTrack : public MidiTrack
+{
+public:
+
+    HeadlessTrack(const String &trackName, int trackChannel) :
+        name(trackName),
+        channel(trackChannel),
+        colour(Colours::white),
+        controllerNumber(0),
+        muted(false) {}
+
+    Uuid getTrackId() const noexcept override { return this->id; }
+    void setTrackId(const Uuid &val) override { this->id = val; }
+    int getTrackChannel() const noexcept override { return this->channel; }
+
+    String getTrackName() const noexcept override { return this->name; }
+    void setTrackName(const String &val) override { this->name = val; }
+
+    Colour getTrackColour() const noexcept override { return this->colour; }
+    void setTrackColour(const Colour &val) override { this->colour = val; }
+
+    String getTrackInstrumentId() const noexcept override { return this->instrumentId; }
+    void setTrackInstrumentId(const String &val) override { this->instrumentId = val; }
+
+    int getTrackControllerNumber() const noexcept override { return this->controllerNumber; }
+    void setTrackControllerNumber(int val) override { this->controllerNumber = val; }
+
+    bool isTrackMuted() const noexcept override { return this->muted; }
+    void setTrackMuted(bool shouldBeMuted) override { this->muted = shouldBeMuted; }
+
+    MidiSequence *getSequence() const noexcept override { return this->sequence; }
+    Pattern *getPattern() const noexcept override { return this->pattern; }
+
+    ScopedPointer<MidiSequence> sequence;
+    ScopedPointer<Pattern> pattern;
+
+private:
+
+    Uuid id;
+    String name;
+    int channel;
+    Colour colour;
+    String instrumentId;
+    int controllerNumber;
+    bool muted;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(HeadlessTrack)
+};
+
+//===----------------------------------------------------------------------===//
+// A single project with its own instrument and transport
+//===----------------------------------------------------------------------===//
+
+class BatchRenderer::Job : public OrchestraPit
+{
+public:
+
+    Job(const File &project, const File &output) :
+        projectFile(project),
+        outputFile(output) {}
+
+    ~Job() override
+    {
+        // stops the renderer before anything else is gone
+        this->transport = nullptr;
+    }
+
+    const File &getProjectFile() const noexcept
+    { return this->projectFile; }
+
+    const File &getOutputFile() const noexcept
+    { return this->outputFile; }
+
+    bool start(AudioPluginFormatManager &formatManager,
+               const RenderFormat &renderFormat, double sampleRate, int numWorkers)
+    {
+        ScopedPointer<ChunkedProjectFile> chunkedFile;
+        ScopedPointer<XmlElement> xml;
+
+        if (ChunkedProjectFile::isChunkedFile(this->projectFile))
+        {
+            chunkedFile = new ChunkedProjectFile(this->projectFile);
+            xml = chunkedFile->createProjectXml();
+        }
+        else
+        {
+            xml = DataEncoder::loadObfuscated(this->projectFile);
+        }
+
+        if (xml == nullptr)
+        { return false; }
+
+        const XmlElement *root = xml->hasTagName(Serialization::Core::project) ?
+            xml.get() : xml->getChildByName(Serialization::Core::project);
+
+        if (root == nullptr)
+        { return false; }
+
+        this->loadTracks(*root, String::empty, chunkedFile);
+
+        // the events aren't needed once they're decoded
+        chunkedFile = nullptr;
+
+        OwnedArray<PluginDescription> descriptions;
+        BuiltInSynthFormat format;
+        format.findAllTypesForFile(descriptions, BuiltInSynth::pianoId);
+
+        if (descriptions.size() == 0)
+        { return false; }
+
+        // the renderer takes the sample rate from the graph
+        this->instrument = new Instrument(formatManager, "Default");
+        this->instrument->getProcessorGraph()->setPlayConfigDetails(0, 2, sampleRate, BATCH_RENDER_BLOCK_SIZE);
+
+        if (! this->instrument->initializeSynchronouslyFrom(*descriptions[0]))
+        { return false; }
+
+        this->transport = new Transport(*this);
+
+        for (auto track : this->tracks)
+        {
+            this->transport->onAddTrack(track);
+        }
+
+        Array<MidiTrack *> allTracks;
+        allTracks.addArray(this->tracks);
+
+        const Point<float> beatRange(ProjectTreeItem::getRangeInBeats(allTracks));
+        this->transport->onChangeProjectBeatRange(beatRange.getX(), beatRange.getY());
+
+        this->transport->setNumRenderWorkers(numWorkers);
+        this->transport->startRender(this->outputFile.getFullPathName(), renderFormat);
+        return this->transport->isRendering();
+    }
+
+    bool isRendering() const
+    {
+        return (this->transport != nullptr) && this->transport->isRendering();
+    }
+
+    RenderResults getResults() const
+    {
+        return (this->transport != nullptr) ? this->transport->getRenderResults() : RenderResults();
+    }
+
+    //===------------------------------------------------------------------===//
+    // OrchestraPit
+    //===------------------------------------------------------------------===//
+
+    Array<Instrument *> getInstruments() const override
+    {
+        Array<Instrument *> result;
+        result.add(this->instrument);
+        return result;
+    }
+
+    Instrument *findInstrumentById(const String &id) const override
+    {
+        return this->instrument;
+    }
+
+private:
+
+    void loadTracks(const XmlElement &parent, const String &parentPath,
+                    const ChunkedProjectFile *eventChunks)
+    {
+        forEachXmlChildElementWithTagName(parent, e, Serialization::Core::treeItem)
+        {
+            const String type = e->getStringAttribute(Serialization::Core::treeItemType);
+            const String name = e->getStringAttribute(Serialization::Core::treeItemName);
+            const String path = parentPath.isEmpty() ? name : (parentPath + TreeItem::xPathSeparator + name);
+
+            const bool isPianoTrack = (type == Serialization::Core::pianoLayer);
+            const bool isAutomationTrack = (type == Serialization::Core::autoLayer);
+
+            if (isPianoTrack || isAutomationTrack)
+            {
+                auto track = new HeadlessTrack(path, e->getIntAttribute(Serialization::Core::trackChannel, 1));
+                track->deserializeTrackProperties(*e);
+
+                if (isPianoTrack)
+                {
+                    track->sequence = new PianoSequence(*track, this->dispatcher);
+                }
+                else
+                {
+                    track->sequence = new AutomationSequence(*track, this->dispatcher);
+                }
+
+                track->pattern = new Pattern(*track, this->dispatcher);
+
+                forEachXmlChildElementWithTagName(*e, patternXml, Serialization::Core::pattern)
+                {
+                    track->pattern->deserialize(*patternXml);
+                }
+
+                const String &sequenceTag = isPianoTrack ?
+                    Serialization::Core::track : Serialization::Core::automation;
+
+                forEachXmlChildElementWithTagName(*e, sequenceXml, sequenceTag)
+                {
+                    track->sequence->deserialize(*sequenceXml);
+                }
+
+                size_t chunkSize = 0;
+                const void *chunkData = (eventChunks != nullptr) ?
+                    eventChunks->getChunkData(track->getTrackId().toString(), chunkSize) : nullptr;
+
+                if (chunkData != nullptr)
+                {
+                    track->sequence->loadBinaryChunk(chunkData, chunkSize);
+                }
+
+                this->tracks.add(track);
+            }
+
+            this->loadTracks(*e, path, eventChunks);
+        }
+    }
+
+    File projectFile;
+    File outputFile;
+
+    EmptyEventDispatcher dispatcher;
+    OwnedArray<HeadlessTrack> tracks;
+    ScopedPointer<Instrument> instrument;
+    ScopedPointer<Transport> transport;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Job)
+};
+
+//===----------------------------------------------------------------------===//
+// BatchRenderer
+//===----------------------------------------------------------------------===//
+
+BatchRenderer::BatchRenderer() :
+    sampleRate(BATCH_RENDER_DEFAULT_SAMPLE_RATE),
+    maxRunningJobs(1),
+    numWorkersPerJob(0),
+    numFailedJobs(0)
+{
+    AudioCore::initAudioFormats(this->formatManager);
+}
+
+BatchRenderer::~BatchRenderer()
+{
+    this->stopTimer();
+    this->runningJobs.clear();
+    this->pendingJobs.clear();
+}
+
+bool BatchRenderer::isBatchRenderCommandLine(const String &commandLine)
+{
+    StringArray toks;
+    toks.addTokens(commandLine, true);
+    return toks.contains(BATCH_RENDER_FLAG);
+}
+
+void BatchRenderer::run(const String &commandLine)
+{
+    StringArray toks;
+    toks.addTokens(commandLine, true);
+    toks.removeEmptyStrings();
+
+    String format(BATCH_RENDER_DEFAULT_FORMAT);
+    File outputFolder;
+    Array<File> projectFiles;
+    this->renderFormat = RenderFormat::fromConfig();
+    int maxJobs = SystemStats::getNumCpus();
+
+    for (int i = 0; i < toks.size(); ++i)
+    {
+        const String tok(toks[i].unquoted());
+        const bool hasValue = (i + 1) < toks.size();
+
+        if (tok == BATCH_RENDER_FLAG)
+        {
+            continue;
+        }
+        else if (tok == "-t" && hasValue)
+        {
+            format = toks[++i].unquoted().toLowerCase().trimCharactersAtStart(".");
+        }
+        else if (tok == "-o" && hasValue)
+        {
+            outputFolder = File::getCurrentWorkingDirectory().getChildFile(toks[++i].unquoted());
+        }
+        else if (tok == "-r" && hasValue)
+        {
+            this->sampleRate = jlimit(8000.0, 192000.0, toks[++i].unquoted().getDoubleValue());
+        }
+        else if (tok == "-b" && hasValue)
+        {
+            const int bitsPerSample = toks[++i].unquoted().getIntValue();
+            this->renderFormat.bitsPerSample = (bitsPerSample == 24 || bitsPerSample == 32) ? bitsPerSample : 16;
+        }
+        else if (tok == "-l" && hasValue)
+        {
+            this->renderFormat.normalize = true;
+            this->renderFormat.targetLoudness = toks[++i].unquoted().getFloatValue();
+        }
+        else if (tok == "-c" && hasValue)
+        {
+            this->renderFormat.truePeakCeiling = toks[++i].unquoted().getFloatValue();
+        }
+        else if (tok == "-j" && hasValue)
+        {
+            maxJobs = jmax(1, toks[++i].unquoted().getIntValue());
+        }
+        else
+        {
+            const File file(File::getCurrentWorkingDirectory().getChildFile(tok));
+
+            if (file.isDirectory())
+            {
+                file.findChildFiles(projectFiles, File::findFiles, false, "*.hp");
+            }
+            else
+            {
+                projectFiles.add(file);
+            }
+        }
+    }
+
+    if (projectFiles.size() == 0 ||
+        (format != "wav" && format != "flac" && format != "ogg"))
+    {
+        printf("Helio --render (project files or folders) [-t wav|flac|ogg] [-b 16|24|32] [-l (target LUFS)] [-c (true peak ceiling)] [-o (output folder)] [-r (sample rate)] [-j (max parallel renders)]\n\n");
+        this->numFailedJobs = 1;
+        this->finish();
+        return;
+    }
+
+    if (outputFolder != File::nonexistent)
+    {
+        outputFolder.createDirectory();
+    }
+
+    for (const auto &projectFile : projectFiles)
+    {
+        const File folder = (outputFolder != File::nonexistent) ? outputFolder : projectFile.getParentDirectory();
+        const File outputFile = folder.getChildFile(projectFile.getFileNameWithoutExtension() + "." + format);
+        this->pendingJobs.add(new Job(projectFile, outputFile));
+    }
+
+    // the cores are shared between projects first, since they are rendered
+    // independently, and whatever is left goes to the renderers' worker pools
+    this->maxRunningJobs = jmin(maxJobs, this->pendingJobs.size());
+    this->numWorkersPerJob = jmax(0, SystemStats::getNumCpus() / this->maxRunningJobs - 1);
+
+    this->startPendingJobs();
+    this->startTimer(BATCH_RENDER_UPDATE_TIME_MS);
+}
+
+void BatchRenderer::startPendingJobs()
+{
+    while (this->runningJobs.size() < this->maxRunningJobs && this->pendingJobs.size() > 0)
+    {
+        Job *job = this->pendingJobs.removeAndReturn(0);
+
+        if (job->start(this->formatManager, this->renderFormat, this->sampleRate, this->numWorkersPerJob))
+        {
+            printf("Rendering %s\n", job->getProjectFile().getFullPathName().toRawUTF8());
+            this->runningJobs.add(job);
+        }
+        else
+        {
+            printf("Failed to render %s\n", job->getProjectFile().getFullPathName().toRawUTF8());
+            ++this->numFailedJobs;
+            delete job;
+        }
+    }
+}
+
+void BatchRenderer::finish()
+{
+    this->stopTimer();
+    JUCEApplicationBase::getInstance()->setApplicationReturnValue(this->numFailedJobs > 0 ? 1 : 0);
+    JUCEApplicationBase::quit();
+}
+
+void BatchRenderer::timerCallback()
+{
+    for (int i = this->runningJobs.size(); --i >= 0;)
+    {
+        Job *job = this->runningJobs.getUnchecked(i);
+
+        if (! job->isRendering())
+        {
+            if (job->getOutputFile().getSize() > 0)
+            {
+                printf("Done %s: %s\n", job->getOutputFile().getFullPathName().toRawUTF8(),
+                       job->getResults().toString().toRawUTF8());
+            }
+            else
+            {
+                printf("Failed to write %s\n", job->getOutputFile().getFullPathName().toRawUTF8());
+                ++this->numFailedJobs;
+            }
+
+            this->runningJobs.remove(i, true);
+        }
+    }
+
+    this->startPendingJobs();
+
+    if (this->runningJobs.size() == 0 && this->pendingJobs.size() == 0)
+    {
+        this->finish();
+    }
+}
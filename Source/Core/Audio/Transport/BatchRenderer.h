@@ -0,0 +1,63 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "RenderFormat.h"
+
+// Command-line mode, which renders a list of projects without any UI
+// or audio device, like: Helio --render a.hp b.hp -t flac -o ~/Mixdowns
+// Every project is played with the built-in piano, several projects are
+// rendered at once, and the app quits when all of them are done.
+
+class BatchRenderer : private Timer
+{
+public:
+
+    BatchRenderer();
+    ~BatchRenderer() override;
+
+    static bool isBatchRenderCommandLine(const String &commandLine);
+
+    void run(const String &commandLine);
+
+private:
+
+    class Job;
+
+    OwnedArray<Job> pendingJobs;
+    OwnedArray<Job> runningJobs;
+
+    AudioPluginFormatManager formatManager;
+
+    RenderFormat renderFormat;
+    double sampleRate;
+    int maxRunningJobs;
+    int numWorkersPerJob;
+    int numFailedJobs;
+
+    void startPendingJobs();
+    void finish();
+
+    //===------------------------------------------------------------------===//
+    // Timer
+    //===------------------------------------------------------------------===//
+
+    void timerCallback() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BatchRenderer)
+};
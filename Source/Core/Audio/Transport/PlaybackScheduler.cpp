@@ -0,0 +1,287 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "PlaybackScheduler.h"
+#include "Transport.h"
+#include "Instrument.h"
+
+PlaybackScheduler::PlaybackScheduler(Transport &parentTransport) :
+    transport(parentTransport),
+    startTimeStamp(0.0),
+    endTimeStamp(0.0),
+    looped(false),
+    started(false),
+    currentTimeStamp(0.0),
+    currentTimeMs(0.0),
+    currentTempo(0.0),
+    finished(0),
+    retiredSequences(nullptr)
+{
+}
+
+PlaybackScheduler::~PlaybackScheduler()
+{
+    delete this->retiredSequences.exchange(nullptr);
+}
+
+void PlaybackScheduler::prepare(const ProjectSequences &projectSequences,
+                                const TempoMap &projectTempoMap,
+                                double startTs, double endTs, bool shouldLoop)
+{
+    delete this->retiredSequences.exchange(nullptr);
+
+    this->sequences = new ProjectSequences(projectSequences);
+    this->sequences->seekToTime(startTs);
+    this->sequences->createInstrumentBuffers(this->instrumentMessages, numReservedEvents);
+    this->tempoMap = projectTempoMap;
+
+    this->holdingNotes.clearQuick();
+    this->holdingNotes.ensureStorageAllocated(numReservedEvents);
+
+    this->startTimeStamp = startTs;
+    this->endTimeStamp = endTs;
+    this->looped = shouldLoop;
+    this->started = false;
+
+    this->currentTimeStamp = startTs;
+    this->currentTimeMs = this->tempoMap.getTimeMsAt(startTs);
+    this->currentTempo = this->tempoMap.getTempoAt(startTs);
+    this->finished = 0;
+}
+
+void PlaybackScheduler::sendHoldingNotesOffAndMidiStop()
+{
+    if (this->sequences == nullptr || this->hasFinished())
+    { return; }
+
+    const double now = Time::getMillisecondCounterHiRes() * 0.001;
+
+    for (const auto &holding : this->holdingNotes)
+    {
+        MidiMessage noteOff(MidiMessage::noteOff(holding.channel, holding.key, 0.f));
+        noteOff.setTimeStamp(now);
+        holding.instrument->getProcessorPlayer().getMidiMessageCollector().addMessageToQueue(noteOff);
+    }
+
+    this->holdingNotes.clearQuick();
+
+    MidiMessage stopPlayback(MidiMessage::midiStop());
+    stopPlayback.setTimeStamp(now);
+
+    for (auto buffer : this->instrumentMessages)
+    {
+        buffer->listener->addMessageToQueue(stopPlayback);
+    }
+}
+
+PendingSequences *PlaybackScheduler::takeRetiredSequences()
+{
+    return this->retiredSequences.exchange(nullptr);
+}
+
+double PlaybackScheduler::getCurrentTimeStamp() const noexcept
+{
+    return this->currentTimeStamp.get();
+}
+
+double PlaybackScheduler::getCurrentTimeMs() const noexcept
+{
+    return this->currentTimeMs.get();
+}
+
+double PlaybackScheduler::getCurrentTempo() const noexcept
+{
+    return this->currentTempo.get();
+}
+
+bool PlaybackScheduler::hasFinished() const noexcept
+{
+    return (this->finished.get() != 0);
+}
+
+
+//===----------------------------------------------------------------------===//
+// Audio thread
+//===----------------------------------------------------------------------===//
+
+void PlaybackScheduler::processNextBlock(int numSamples, double sampleRate)
+{
+    if (this->sequences == nullptr || this->hasFinished() || sampleRate <= 0.0)
+    { return; }
+
+    // the events not consumed by a muted instrument are out of date
+    for (auto buffer : this->instrumentMessages)
+    {
+        buffer->instrument->getScheduledMidi().clear();
+    }
+
+    this->pickUpPendingSequences();
+
+    if (! this->started)
+    {
+        this->scheduleEverywhere(MidiMessage::midiStart(), 0);
+        this->started = true;
+    }
+
+    const double msPerSample = 1000.0 / sampleRate;
+    int blockOffset = 0;
+
+    while (blockOffset < numSamples)
+    {
+        // the tempo map already knows about all tempo changes,
+        // so the window is exact, and no re-calculation is needed on tempo events
+        const double segmentStartMs = this->currentTimeMs.get();
+        const double segmentEndMs = segmentStartMs + (numSamples - blockOffset) * msPerSample;
+        const double segmentEndTimeStamp = jmin(this->tempoMap.getTimeStampAt(segmentEndMs), this->endTimeStamp);
+
+        for (auto buffer : this->instrumentMessages)
+        {
+            buffer->messages.clearQuick();
+        }
+
+        while (this->sequences->drainMessagesUntil(segmentEndTimeStamp, this->instrumentMessages)) {}
+
+        for (auto buffer : this->instrumentMessages)
+        {
+            for (const auto &message : buffer->messages)
+            {
+                const double messageMs = this->tempoMap.getTimeMsAt(message.getTimeStamp());
+                const int sampleNumber = blockOffset + int((messageMs - segmentStartMs) / msPerSample);
+                this->scheduleMessage(message, buffer->instrument, jlimit(blockOffset, numSamples - 1, sampleNumber));
+            }
+        }
+
+        if (segmentEndTimeStamp < this->endTimeStamp)
+        {
+            this->currentTimeStamp = segmentEndTimeStamp;
+            this->currentTimeMs = segmentEndMs;
+            break;
+        }
+
+        // reached the end within this block
+        const double endMs = this->tempoMap.getTimeMsAt(this->endTimeStamp);
+        const int endOffset = jlimit(blockOffset, numSamples - 1,
+                                     blockOffset + int((endMs - segmentStartMs) / msPerSample));
+
+        this->scheduleHoldingNotesOff(endOffset);
+
+        if (this->looped)
+        {
+            this->sequences->seekToTime(this->startTimeStamp);
+            this->currentTimeStamp = this->startTimeStamp;
+            this->currentTimeMs = this->tempoMap.getTimeMsAt(this->startTimeStamp);
+            blockOffset = jmax(endOffset, blockOffset + 1);
+        }
+        else
+        {
+            this->scheduleEverywhere(MidiMessage::midiStop(), endOffset);
+            this->currentTimeStamp = this->endTimeStamp;
+            this->currentTimeMs = endMs;
+            this->finished = 1;
+            break;
+        }
+    }
+
+    this->currentTempo = this->tempoMap.getTempoAt(this->currentTimeStamp.get());
+}
+
+void PlaybackScheduler::pickUpPendingSequences()
+{
+    // the previous copy is still to be freed by the message thread
+    if (this->retiredSequences.get() != nullptr)
+    { return; }
+
+    PendingSequences *pending = this->transport.takePendingSequences();
+
+    if (pending == nullptr)
+    { return; }
+
+    // notes on the edited tracks may have lost their note-offs
+    for (int i = this->holdingNotes.size(); --i >= 0;)
+    {
+        const HoldingNote &holding = this->holdingNotes.getReference(i);
+
+        if (pending->changedListeners.contains(&holding.instrument->getProcessorPlayer().getMidiMessageCollector()))
+        {
+            holding.instrument->getScheduledMidi().addEvent(MidiMessage::noteOff(holding.channel, holding.key, 0.f), 0);
+            this->holdingNotes.remove(i);
+        }
+    }
+
+    // the project's range might have changed, which moves all timestamps
+    const double timeStamp = this->currentTimeStamp.get() + pending->timeShift;
+    this->startTimeStamp = pending->startTimeStamp;
+    this->endTimeStamp = pending->endTimeStamp;
+
+    // everything before the current block has been sent already
+    pending->sequences->seekToTime(timeStamp);
+
+    // the copy, its buffers and the tempo map are prepared by the transport,
+    // the replaced ones go back with the same object
+    this->sequences.swapWith(pending->sequences);
+    this->instrumentMessages.swapWith(pending->instrumentMessages);
+    this->tempoMap.swapWith(pending->tempoMap);
+    this->retiredSequences = pending;
+
+    this->currentTimeStamp = timeStamp;
+    this->currentTimeMs = this->tempoMap.getTimeMsAt(timeStamp);
+}
+
+void PlaybackScheduler::scheduleMessage(const MidiMessage &message, Instrument *instrument, int sampleNumber)
+{
+    instrument->getScheduledMidi().addEvent(message, sampleNumber);
+
+    if (message.isNoteOn())
+    {
+        const HoldingNote holding = { message.getNoteNumber(), message.getChannel(), instrument };
+        this->holdingNotes.add(holding);
+    }
+    else if (message.isNoteOff())
+    {
+        for (int i = 0; i < this->holdingNotes.size(); ++i)
+        {
+            const HoldingNote &holding = this->holdingNotes.getReference(i);
+
+            if (holding.key == message.getNoteNumber() &&
+                holding.channel == message.getChannel() &&
+                holding.instrument == instrument)
+            {
+                this->holdingNotes.remove(i);
+                break;
+            }
+        }
+    }
+}
+
+void PlaybackScheduler::scheduleHoldingNotesOff(int sampleNumber)
+{
+    for (const auto &holding : this->holdingNotes)
+    {
+        holding.instrument->getScheduledMidi().addEvent(MidiMessage::noteOff(holding.channel, holding.key, 0.f), sampleNumber);
+    }
+
+    this->holdingNotes.clearQuick();
+}
+
+void PlaybackScheduler::scheduleEverywhere(const MidiMessage &message, int sampleNumber)
+{
+    for (auto buffer : this->instrumentMessages)
+    {
+        buffer->instrument->getScheduledMidi().addEvent(message, sampleNumber);
+    }
+}
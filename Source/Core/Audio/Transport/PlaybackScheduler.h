@@ -0,0 +1,99 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+class Transport;
+
+#include "ProjectSequencesWrapper.h"
+#include "TempoMap.h"
+
+// Owned by Transport, driven by AudioCore's audio callback.
+// Instead of sleeping between events like PlayerThread does, it is called
+// before every realtime block and writes all events that fall inside
+// that block's sample window into the instruments' MIDI buffers,
+// with sample offsets calculated just like in RendererThread.
+
+class PlaybackScheduler
+{
+public:
+
+    explicit PlaybackScheduler(Transport &parentTransport);
+    ~PlaybackScheduler();
+
+    // Enough for most of the blocks, so that the audio thread rarely allocates
+    static const int numReservedEvents = 512;
+
+    // Message thread, only while not attached to the audio callback
+    void prepare(const ProjectSequences &projectSequences,
+                 const TempoMap &projectTempoMap,
+                 double startTs,
+                 double endTs,
+                 bool shouldLoop);
+
+    void sendHoldingNotesOffAndMidiStop();
+
+    // The sequences and buffers replaced at block boundaries
+    // are handed back here, so that the audio thread never frees memory
+    PendingSequences *takeRetiredSequences();
+
+    // Audio thread
+    void processNextBlock(int numSamples, double sampleRate);
+
+    // Any thread
+    double getCurrentTimeStamp() const noexcept;
+    double getCurrentTimeMs() const noexcept;
+    double getCurrentTempo() const noexcept;
+    bool hasFinished() const noexcept;
+
+private:
+
+    Transport &transport;
+
+    ScopedPointer<ProjectSequences> sequences;
+    OwnedArray<InstrumentMessages> instrumentMessages;
+    TempoMap tempoMap;
+
+    double startTimeStamp;
+    double endTimeStamp;
+    bool looped;
+    bool started;
+
+    Atomic<double> currentTimeStamp;
+    Atomic<double> currentTimeMs;
+    Atomic<double> currentTempo;
+    Atomic<int> finished;
+
+    Atomic<PendingSequences *> retiredSequences;
+
+    struct HoldingNote
+    {
+        int key;
+        int channel;
+        Instrument *instrument;
+    };
+
+    // never shrinks below the reserved size on removals
+    Array<HoldingNote, DummyCriticalSection, numReservedEvents> holdingNotes;
+
+    void pickUpPendingSequences();
+    void scheduleMessage(const MidiMessage &message, Instrument *instrument, int sampleNumber);
+    void scheduleHoldingNotesOff(int sampleNumber);
+    void scheduleEverywhere(const MidiMessage &message, int sampleNumber);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PlaybackScheduler)
+};
@@ -31,7 +31,8 @@
 
 PlayerThread::PlayerThread(Transport &parentTransport) :
     Thread("PlayerThread"),
-    transport(parentTransport)
+    transport(parentTransport),
+    currentTimeStamp(0.0)
 {
 }
 
@@ -40,6 +41,11 @@ PlayerThread::~PlayerThread()
     this->stopThread(100);
 }
 
+double PlayerThread::getCurrentTimeStamp() const noexcept
+{
+    return this->currentTimeStamp.get();
+}
+
 
 //===----------------------------------------------------------------------===//
 // Thread
@@ -69,11 +75,12 @@ void PlayerThread::run()
     
     this->transport.broadcastTempoChanged(msPerTick);
     
-    const double startPositionInTime = round(absStartPosition * this->transport.getTotalTime());
-    const double endPositionInTime = round(absEndPosition * this->transport.getTotalTime());
+    double startPositionInTime = round(absStartPosition * this->transport.getTotalTime());
+    double endPositionInTime = round(absEndPosition * this->transport.getTotalTime());
     
     sequences.seekToTime(startPositionInTime);
     double prevTimeStamp = startPositionInTime;
+    this->currentTimeStamp = prevTimeStamp;
     
     // This hack is here to keep track of still playing events
     // to be able to send noteOff's when playback interrupts.
@@ -97,6 +104,22 @@ void PlayerThread::run()
         }
     };
 
+    auto sendHoldingNotesOff = [&holdingNotes](const Array<MidiMessageCollector *> &listeners)
+    {
+        for (int i = holdingNotes.size(); --i >= 0;)
+        {
+            const HoldingNote &holding = holdingNotes.getReference(i);
+
+            if (listeners.contains(holding.listener))
+            {
+                MidiMessage noteOff(MidiMessage::noteOff(holding.channel, holding.key, 0.f));
+                noteOff.setTimeStamp(Time::getMillisecondCounterHiRes() * 0.001);
+                holding.listener->addMessageToQueue(noteOff);
+                holdingNotes.remove(i);
+            }
+        }
+    };
+
     auto sendHoldingNotesOffAndMidiStop = [&holdingNotes, &uniqueInstruments]()
     {
         for (const auto &holding : holdingNotes)
@@ -131,6 +154,29 @@ void PlayerThread::run()
     
     while (1)
     {
+        // Pick up the edits made during playback, if any,
+        // as soon as all messages at the current timestamp are sent
+        if (sequences.getNextTimeStamp() > prevTimeStamp)
+        {
+            ScopedPointer<PendingSequences> pending(this->transport.takePendingSequences());
+            
+            if (pending != nullptr)
+            {
+                // notes on the edited tracks may have lost their note-offs
+                sendHoldingNotesOff(pending->sequences->getListenersChangedSince(sequences));
+                
+                // the project's range might have changed, which moves all timestamps
+                prevTimeStamp += pending->timeShift;
+                startPositionInTime = pending->startTimeStamp;
+                endPositionInTime = pending->endTimeStamp;
+                this->currentTimeStamp = prevTimeStamp;
+
+                sequences = *pending->sequences;
+                sequences.seekAfterTime(prevTimeStamp);
+                uniqueInstruments = sequences.getUniqueInstruments();
+            }
+        }
+        
         MessageWrapper wrapper;
 
         if (! sequences.getNextMessage(wrapper))
@@ -174,6 +220,7 @@ void PlayerThread::run()
                 //Logger::writeToLog("Sekk to time " + String(startPositionInTime));
                 sequences.seekToTime(startPositionInTime);
                 prevTimeStamp = startPositionInTime;
+                this->currentTimeStamp = prevTimeStamp;
                 continue;
             }
             else
@@ -237,6 +284,7 @@ void PlayerThread::run()
 #endif
         
         prevTimeStamp = nextEventTimeStamp;
+        this->currentTimeStamp = prevTimeStamp;
 
         this->transport.broadcastSeek(prevTimeStamp / this->transport.getTotalTime(),
                                       currentTimeMs, totalTimeMs);
@@ -245,6 +293,7 @@ void PlayerThread::run()
         {
             sequences.seekToTime(startPositionInTime);
             prevTimeStamp = startPositionInTime;
+            this->currentTimeStamp = prevTimeStamp;
         }
         else
         {
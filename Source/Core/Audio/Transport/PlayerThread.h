@@ -35,9 +35,13 @@ public:
 
     ~PlayerThread() override;
 
+    // The timestamp of the last sent event, any thread
+    double getCurrentTimeStamp() const noexcept;
+
 protected:
 
     Transport &transport;
+    Atomic<double> currentTimeStamp;
 
     //===------------------------------------------------------------------===//
     // Thread
@@ -18,17 +18,70 @@
 #pragma once
 
 #include "Instrument.h"
+#include "MidiSequence.h"
+#include "TempoMap.h"
 #include <float.h>
 
-class MidiSequence;
-
+// A lazy view over a track's exported sequence, shifted in time:
+// every clip of a track gets one, and all of them share the same events,
+// so that repeating a clip costs nothing but a wrapper
 struct SequenceWrapper : public ReferenceCountedObject
 {
-    MidiMessageSequence sequence;
-    int currentIndex;
+    SequenceWrapper() : timeOffset(0.0) {}
+
+    // Shared with the track's export cache, so it's never modified;
+    // the clip's and the transport's offset is applied on reading
+    MidiSequence::ExportedMidi::Ptr midi;
+    double timeOffset;
+
     MidiMessageCollector *listener;
     Instrument *instrument;
     const MidiSequence *layer;
+
+    inline int getNumEvents() const noexcept
+    {
+        return (this->midi != nullptr) ? this->midi->getNumEvents() : 0;
+    }
+
+    // Note that the message's own timestamp has no offset applied
+    inline const MidiMessage &getEvent(int index) const noexcept
+    {
+        return this->midi->getMessage(index);
+    }
+
+    inline double getTimeStamp(int index) const noexcept
+    {
+        return this->midi->getTimeStamp(index) + this->timeOffset;
+    }
+
+    MidiMessage getMessage(int index) const
+    {
+        MidiMessage message(this->getEvent(index));
+        message.addToTimeStamp(this->timeOffset);
+        return message;
+    }
+
+    // Index of the first event with timestamp >= given one, or numEvents
+    int getNextIndexAtTime(const double timeStamp) const noexcept
+    {
+        return this->findIndex(timeStamp, false);
+    }
+
+    // Index of the first event with timestamp > given one, or numEvents
+    int getNextIndexAfterTime(const double timeStamp) const noexcept
+    {
+        return this->findIndex(timeStamp, true);
+    }
+
+    int findIndex(const double timeStamp, bool skipEqual) const noexcept
+    {
+        if (this->midi == nullptr)
+        { return 0; }
+
+        // searching in the shared timestamps, so the offset is applied to the target
+        return this->midi->findIndex(timeStamp - this->timeOffset, skipEqual);
+    }
+
     typedef ReferenceCountedObjectPtr<SequenceWrapper> Ptr;
 };
 
@@ -40,6 +93,14 @@ struct MessageWrapper : public ReferenceCountedObject
     typedef ReferenceCountedObjectPtr<MessageWrapper> Ptr;
 };
 
+// A target for bulk reads, one per unique instrument
+struct InstrumentMessages
+{
+    Instrument *instrument;
+    MidiMessageCollector *listener;
+    Array<MidiMessage> messages;
+};
+
 // TODO: add modifiers like random delays and so forth
 
 class ProjectSequences
@@ -49,14 +110,153 @@ private:
     Array<Instrument *> uniqueInstruments;
     ReferenceCountedArray<SequenceWrapper> sequences;
 
+    // Playback cursor: sequences are merged with a binary min-heap,
+    // keyed by the timestamp of each sequence's next message,
+    // so that every read costs O(log(numSequences)).
+    // Cursor state is kept per ProjectSequences instance, not in
+    // the shared wrappers, so that copies could be iterated independently.
+
+    struct CursorNode
+    {
+        double timeStamp;
+        int sequenceIndex;
+    };
+
+    Array<int> currentIndices;
+    Array<int> instrumentIndices;
+    Array<CursorNode> cursorHeap;
+
+    static inline bool isEarlier(const CursorNode &a, const CursorNode &b) noexcept
+    {
+        // on equal timestamps, earlier added sequences go first
+        return (a.timeStamp < b.timeStamp) ||
+            (a.timeStamp == b.timeStamp && a.sequenceIndex < b.sequenceIndex);
+    }
+
+    void siftUp(int i) noexcept
+    {
+        const CursorNode node = this->cursorHeap.getUnchecked(i);
+
+        while (i > 0)
+        {
+            const int parent = (i - 1) / 2;
+            const CursorNode &parentNode = this->cursorHeap.getReference(parent);
+
+            if (! isEarlier(node, parentNode))
+            { break; }
+
+            this->cursorHeap.setUnchecked(i, parentNode);
+            i = parent;
+        }
+
+        this->cursorHeap.setUnchecked(i, node);
+    }
+
+    void siftDown(int i) noexcept
+    {
+        const int size = this->cursorHeap.size();
+        const CursorNode node = this->cursorHeap.getUnchecked(i);
+
+        while (true)
+        {
+            int child = i * 2 + 1;
+
+            if (child >= size)
+            { break; }
+
+            if (child + 1 < size &&
+                isEarlier(this->cursorHeap.getReference(child + 1), this->cursorHeap.getReference(child)))
+            {
+                ++child;
+            }
+
+            if (! isEarlier(this->cursorHeap.getReference(child), node))
+            { break; }
+
+            this->cursorHeap.setUnchecked(i, this->cursorHeap.getUnchecked(child));
+            i = child;
+        }
+
+        this->cursorHeap.setUnchecked(i, node);
+    }
+
+    void rebuildCursor()
+    {
+        // keeps the cursor rebuilds on the audio thread free of allocations
+        this->cursorHeap.ensureStorageAllocated(this->sequences.size());
+        this->cursorHeap.clearQuick();
+
+        for (int i = 0; i < this->sequences.size(); ++i)
+        {
+            const SequenceWrapper *wrapper = this->sequences.getUnchecked(i);
+            const int index = this->currentIndices.getUnchecked(i);
+
+            if (index < wrapper->getNumEvents())
+            {
+                const CursorNode node = { wrapper->getTimeStamp(index), i };
+                this->cursorHeap.add(node);
+            }
+        }
+
+        for (int i = this->cursorHeap.size() / 2; --i >= 0;)
+        {
+            this->siftDown(i);
+        }
+    }
+
+    // Adds a wrapper without touching the cursor
+    void appendWrapper(SequenceWrapper *const newWrapper)
+    {
+        this->uniqueInstruments.addIfNotAlreadyThere(newWrapper->instrument);
+        this->instrumentIndices.add(this->uniqueInstruments.indexOf(newWrapper->instrument));
+        this->currentIndices.add(0);
+        this->sequences.add(newWrapper);
+    }
+
+    // Returns the top message and moves its sequence forward
+    MidiMessage popNextMessage(int &outSequenceIndex)
+    {
+        CursorNode &top = this->cursorHeap.getReference(0);
+        outSequenceIndex = top.sequenceIndex;
+
+        const SequenceWrapper *wrapper = this->sequences.getUnchecked(top.sequenceIndex);
+        int &index = this->currentIndices.getReference(top.sequenceIndex);
+        const MidiMessage message(wrapper->getMessage(index));
+        index++;
+
+        // finished sequences sink to the bottom instead of being removed,
+        // as removing from an Array may shrink its storage
+        top.timeStamp = (index < wrapper->getNumEvents()) ?
+            wrapper->getTimeStamp(index) : DBL_MAX;
+
+        this->siftDown(0);
+
+        return message;
+    }
+
 public:
     
     ProjectSequences() {}
     
     ProjectSequences(const ProjectSequences &other) :
+    uniqueInstruments(other.uniqueInstruments),
     sequences(other.sequences),
-    uniqueInstruments(other.uniqueInstruments)
+    currentIndices(other.currentIndices),
+    instrumentIndices(other.instrumentIndices),
+    cursorHeap(other.cursorHeap)
     {
+        this->cursorHeap.ensureStorageAllocated(this->sequences.size());
+    }
+
+    ProjectSequences &operator=(const ProjectSequences &other)
+    {
+        this->uniqueInstruments = other.uniqueInstruments;
+        this->sequences = other.sequences;
+        this->currentIndices = other.currentIndices;
+        this->instrumentIndices = other.instrumentIndices;
+        this->cursorHeap = other.cursorHeap;
+        this->cursorHeap.ensureStorageAllocated(this->sequences.size());
+        return *this;
     }
     
     Array<Instrument *> getUniqueInstruments() const
@@ -64,16 +264,79 @@ public:
         return this->uniqueInstruments;
     }
     
-    SequenceWrapper *addWrapper(SequenceWrapper *const newWrapper) noexcept
+    SequenceWrapper *addWrapper(SequenceWrapper *const newWrapper)
     {
-        this->uniqueInstruments.addIfNotAlreadyThere(newWrapper->instrument);
-        return this->sequences.add(newWrapper);
+        this->appendWrapper(newWrapper);
+
+        if (newWrapper->getNumEvents() > 0)
+        {
+            const CursorNode node = { newWrapper->getTimeStamp(0), this->sequences.size() - 1 };
+            this->cursorHeap.add(node);
+            this->siftUp(this->cursorHeap.size() - 1);
+        }
+
+        return newWrapper;
+    }
+    
+    // Replaces all wrappers for the given layer, one per clip;
+    // wrappers are shared between copies, so they are never modified in place
+    void updateWrappers(const MidiSequence *layer, const ReferenceCountedArray<SequenceWrapper> &newWrappers)
+    {
+        for (int i = this->sequences.size(); --i >= 0;)
+        {
+            if (this->sequences.getUnchecked(i)->layer == layer)
+            {
+                this->sequences.remove(i);
+                this->currentIndices.remove(i);
+                this->instrumentIndices.remove(i);
+            }
+        }
+
+        for (auto wrapper : newWrappers)
+        {
+            jassert(wrapper->layer == layer);
+            this->appendWrapper(wrapper);
+        }
+
+        this->rebuildCursor();
+    }
+
+    // Listeners of the sequences which are not shared with the other copy
+    Array<MidiMessageCollector *> getListenersChangedSince(const ProjectSequences &other) const
+    {
+        Array<MidiMessageCollector *> result;
+
+        for (auto wrapper : this->sequences)
+        {
+            if (! other.sequences.contains(wrapper))
+            {
+                result.addIfNotAlreadyThere(wrapper->listener);
+            }
+        }
+
+        return result;
+    }
+
+    Instrument *getInstrumentFor(const MidiSequence *layer) const
+    {
+        for (int i = 0; i < this->sequences.size(); ++i)
+        {
+            if (this->sequences.getUnchecked(i)->layer == layer)
+            {
+                return this->sequences.getUnchecked(i)->instrument;
+            }
+        }
+
+        return nullptr;
     }
     
     void clear()
     {
         this->uniqueInstruments.clear();
         this->sequences.clear();
+        this->currentIndices.clear();
+        this->instrumentIndices.clear();
+        this->cursorHeap.clear();
     }
     
     bool empty() const
@@ -108,7 +371,7 @@ public:
         return this->sequences[0]->instrument->getProcessorGraph()->getTotalNumInputChannels();
     }
 
-    ReferenceCountedArray<SequenceWrapper> getAllFor(const MidiSequence *midiLayer)
+    ReferenceCountedArray<SequenceWrapper> getAllFor(const MidiSequence *midiLayer) const
     {
         ReferenceCountedArray<SequenceWrapper> result;
         
@@ -129,74 +392,104 @@ public:
     {
         for (int i = 0; i < this->sequences.size(); ++i)
         {
-            SequenceWrapper *wrapper = this->sequences.getUnchecked(i);
-            wrapper->currentIndex = this->getNextIndexAtTime(wrapper->sequence, (position - DBL_MIN));
+            const SequenceWrapper *wrapper = this->sequences.getUnchecked(i);
+            this->currentIndices.set(i, wrapper->getNextIndexAtTime(position - DBL_MIN));
         }
+
+        this->rebuildCursor();
     }
     
-    int getNextIndexAtTime(const MidiMessageSequence &sequence,
-                           const double timeStamp) const
+    // Used to continue from the same point in a freshly rebuilt copy
+    void seekAfterTime(double position)
     {
-        const int numEvents = sequence.getNumEvents();
-        
-        int i = 0;
-        for (; i < numEvents; ++i)
+        for (int i = 0; i < this->sequences.size(); ++i)
         {
-            if (sequence.getEventPointer(i)->message.getTimeStamp() >= timeStamp)
-            {
-                break;
-            }
+            const SequenceWrapper *wrapper = this->sequences.getUnchecked(i);
+            this->currentIndices.set(i, wrapper->getNextIndexAfterTime(position));
         }
-        
-        return i;
+
+        this->rebuildCursor();
     }
-    
+
     void seekToZeroIndexes()
     {
         for (int i = 0; i < this->sequences.size(); ++i)
         {
-            this->sequences.getUnchecked(i)->currentIndex = 0;
+            this->currentIndices.set(i, 0);
         }
+
+        this->rebuildCursor();
+    }
+
+    bool hasNextMessage() const noexcept
+    {
+        return (this->cursorHeap.size() > 0 &&
+                this->cursorHeap.getReference(0).timeStamp < DBL_MAX);
+    }
+
+    double getNextTimeStamp() const noexcept
+    {
+        return this->hasNextMessage() ? this->cursorHeap.getReference(0).timeStamp : DBL_MAX;
     }
     
     bool getNextMessage(MessageWrapper &target)
     {
-        double minTimeStamp = DBL_MAX;
-        int targetSequenceIndex = -1;
+        if (! this->hasNextMessage())
+        { return false; }
+
+        int sequenceIndex = 0;
+        target.message = this->popNextMessage(sequenceIndex);
+
+        const SequenceWrapper *foundWrapper = this->sequences.getUnchecked(sequenceIndex);
+        target.listener = foundWrapper->listener;
+        target.instrument = foundWrapper->instrument;
+
+        return true;
+    }
+
+    void createInstrumentBuffers(OwnedArray<InstrumentMessages> &result, int numReservedEvents = 0) const
+    {
+        result.clear();
 
-        for (int i = 0; i < this->sequences.size(); ++i)
+        for (int i = 0; i < this->uniqueInstruments.size(); ++i)
         {
-            SequenceWrapper *wrapper = this->sequences.getUnchecked(i);
+            auto buffer = new InstrumentMessages();
+            buffer->instrument = this->uniqueInstruments.getUnchecked(i);
+            buffer->listener = &buffer->instrument->getProcessorPlayer().getMidiMessageCollector();
+            buffer->messages.ensureStorageAllocated(numReservedEvents);
+            result.add(buffer);
+        }
+    }
 
-            if (wrapper->currentIndex < wrapper->sequence.getNumEvents())
-            {
-                MidiMessage &message = wrapper->sequence.getEventPointer(wrapper->currentIndex)->message;
+    // Moves all messages earlier than endTimeStamp into the buffers created
+    // by createInstrumentBuffers(), in time order for each instrument.
+    // Tempo events are sent to every instrument (need to do that for drum-machines),
+    // and reading stops right after one, so that the caller could re-calculate
+    // its time window; returns true in that case.
+    bool drainMessagesUntil(double endTimeStamp, OwnedArray<InstrumentMessages> &target)
+    {
+        jassert(target.size() == this->uniqueInstruments.size());
 
-                if (message.getTimeStamp() < minTimeStamp)
+        while (this->hasNextMessage() &&
+               this->cursorHeap.getReference(0).timeStamp < endTimeStamp)
+        {
+            int sequenceIndex = 0;
+            const MidiMessage message(this->popNextMessage(sequenceIndex));
+
+            if (message.isTempoMetaEvent())
+            {
+                for (auto buffer : target)
                 {
-                    minTimeStamp = message.getTimeStamp();
-                    targetSequenceIndex = i;
+                    buffer->messages.add(message);
                 }
-            }
-        }
 
-        if (targetSequenceIndex < 0)
-        { return false; }
+                return true;
+            }
 
-        SequenceWrapper *foundWrapper = this->sequences.getUnchecked(targetSequenceIndex);
-        MidiMessage &foundMessage = foundWrapper->sequence.getEventPointer(foundWrapper->currentIndex)->message;
-        foundWrapper->currentIndex++;
-        
-        //if (foundMessage.isTempoMetaEvent())
-        //{
-        //    Logger::writeToLog("foundMessage.isTempoMetaEvent");
-        //}
-        
-        target.message = foundMessage;
-        target.listener = foundWrapper->listener;
-        target.instrument = foundWrapper->instrument;
+            target.getUnchecked(this->instrumentIndices.getUnchecked(sequenceIndex))->messages.add(message);
+        }
 
-        return true;
+        return false;
     }
 
     double getLastEventTimestamp() const
@@ -206,7 +499,8 @@ public:
         for (int i = 0; i < this->sequences.size(); ++i)
         {
             const SequenceWrapper *wrapper = this->sequences.getUnchecked(i);
-            const double &endTime = wrapper->sequence.getEndTime();
+            const int numEvents = wrapper->getNumEvents();
+            const double endTime = (numEvents > 0) ? wrapper->getTimeStamp(numEvents - 1) : 0.0;
 
             if (lastEventTimestamp < endTime)
             {
@@ -219,3 +513,26 @@ public:
     
     JUCE_LEAK_DETECTOR(ProjectSequences)
 };
+
+// A fresh copy of sequences, prepared on the message thread along with
+// everything the realtime scheduler needs to switch to it; after the switch,
+// the same object carries the replaced data back to be freed there
+struct PendingSequences
+{
+    PendingSequences() :
+        timeShift(0.0),
+        startTimeStamp(0.0),
+        endTimeStamp(0.0) {}
+
+    ScopedPointer<ProjectSequences> sequences;
+    OwnedArray<InstrumentMessages> instrumentMessages;
+    Array<MidiMessageCollector *> changedListeners;
+
+    // All timestamps are relative to the project's start, so when
+    // the project's range changes, the player's position is shifted
+    // by this much, and it continues within the new range
+    double timeShift;
+    double startTimeStamp;
+    double endTimeStamp;
+    TempoMap tempoMap;
+};
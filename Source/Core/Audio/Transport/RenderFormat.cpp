@@ -0,0 +1,60 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "RenderFormat.h"
+#include "SerializationKeys.h"
+#include "Config.h"
+
+RenderFormat RenderFormat::fromConfig()
+{
+    RenderFormat format;
+
+    const int bitsPerSample = Config::get(Serialization::Core::renderBitDepth).getIntValue();
+
+    if (bitsPerSample == 16 || bitsPerSample == 24 || bitsPerSample == 32)
+    {
+        format.bitsPerSample = bitsPerSample;
+    }
+
+    format.dither = (Config::get(Serialization::Core::renderDither) != Serialization::Core::disabledState);
+
+    const String targetLoudness = Config::get(Serialization::Core::renderTargetLoudness);
+    format.normalize = targetLoudness.isNotEmpty();
+
+    if (format.normalize)
+    {
+        format.targetLoudness = targetLoudness.getFloatValue();
+    }
+
+    const String truePeakCeiling = Config::get(Serialization::Core::renderTruePeakCeiling);
+
+    if (truePeakCeiling.isNotEmpty())
+    {
+        format.truePeakCeiling = truePeakCeiling.getFloatValue();
+    }
+
+    return format;
+}
+
+String RenderResults::toString() const
+{
+    return String(this->loudness, 1) + " LUFS, " +
+        String(this->truePeak, 1) + " dBTP, " +
+        String(this->samplePeak, 1) + " dBFS peak, " +
+        String(this->gain, 1) + " dB gain";
+}
@@ -0,0 +1,54 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Sample format and mastering options of the renderer
+struct RenderFormat
+{
+    RenderFormat() :
+        bitsPerSample(16),
+        dither(true),
+        normalize(false),
+        targetLoudness(-14.f),
+        truePeakCeiling(-1.f) {}
+
+    int bitsPerSample;      // 16, 24, or 32 for floating point samples
+    bool dither;            // TPDF dither when reducing to integer samples
+    bool normalize;         // pre-scan the mix, then fit it into the targets below
+    float targetLoudness;   // LUFS, integrated
+    float truePeakCeiling;  // dBTP
+
+    static RenderFormat fromConfig();
+};
+
+// What the mix turned out to be, after the gain is applied
+struct RenderResults
+{
+    RenderResults() :
+        samplePeak(0.f),
+        truePeak(0.f),
+        loudness(0.f),
+        gain(0.f) {}
+
+    float samplePeak;       // dBFS
+    float truePeak;         // dBTP
+    float loudness;         // LUFS, integrated
+    float gain;             // dB, calculated by the pre-scan
+
+    String toString() const;
+};
@@ -19,17 +19,26 @@
 #include "RendererThread.h"
 #include "ProjectSequencesWrapper.h"
 #include "Instrument.h"
+#include "MidiSequence.h"
+#include "MidiTrack.h"
 #include "Supervisor.h"
 #include "SerializationKeys.h"
-#include "App.h"
-#include "Workspace.h"
 #include "AudioCore.h"
+#include "AudioWorkerPool.h"
+#include "LoudnessMeter.h"
+#include "Config.h"
+
+#define RENDER_DEFAULT_BLOCK_SIZE 512
+#define RENDER_NUM_BLOCKS_IN_WRITER_RING 32
 
 RendererThread::RendererThread(Transport &parentTrasport) :
     Thread("RendererThread"),
     transport(parentTrasport),
     writer(nullptr),
-    percentsDone(0.f)
+    writerThread("RendererWriterThread"),
+    percentsDone(0.f),
+    ditherBits(0),
+    numWorkers(-1)
 {
 }
 
@@ -45,62 +54,260 @@ float RendererThread::getPercentsComplete() const
 }
 
 
-void RendererThread::startRecording(const File &file)
+// Not every format supports every bit depth, e.g. there is no float FLAC,
+// so the best one below the requested is used
+static int getBitsPerSampleFor(AudioFormat &format, int requestedBits)
+{
+    const Array<int> possibleDepths(format.getPossibleBitDepths());
+
+    if (possibleDepths.contains(requestedBits))
+    {
+        return requestedBits;
+    }
+
+    int bestBits = 0;
+
+    for (const auto bits : possibleDepths)
+    {
+        if (bits < requestedBits)
+        {
+            bestBits = jmax(bestBits, bits);
+        }
+    }
+
+    return (bestBits > 0) ? bestBits : requestedBits;
+}
+
+static AudioFormatWriter *createWriterFor(const File &file, double sampleRate, int numChannels, int bitsPerSample)
+{
+    // Create an OutputStream to write to our destination file...
+    file.deleteFile();
+    ScopedPointer<FileOutputStream> fileStream(file.createOutputStream());
+
+    if (fileStream == nullptr)
+    {
+        return nullptr;
+    }
+
+    ScopedPointer<AudioFormat> format;
+    const String extension = file.getFileExtension().toLowerCase();
+
+    if (extension == ".wav")
+    {
+        format = new WavAudioFormat();
+    }
+    else if (extension == ".ogg")
+    {
+        format = new OggVorbisAudioFormat();
+    }
+    else if (extension == ".flac")
+    {
+        format = new FlacAudioFormat();
+    }
+
+    if (format == nullptr)
+    {
+        return nullptr;
+    }
+
+    AudioFormatWriter *writer = format->createWriterFor(fileStream, sampleRate, numChannels,
+        getBitsPerSampleFor(*format, bitsPerSample), StringPairArray(), 0);
+
+    if (writer != nullptr)
+    {
+        fileStream.release(); // (passes responsibility for deleting the stream to the writer object that is now using it)
+    }
+
+    return writer;
+}
+
+static File getStemFile(const File &file, const String &stemName, StringArray &usedNames)
+{
+    String name = File::createLegalFileName(stemName.isEmpty() ? String("Stem") : stemName);
+    const String baseName = name;
+
+    for (int i = 2; usedNames.contains(name, true); ++i)
+    {
+        name = baseName + " " + String(i);
+    }
+
+    usedNames.add(name);
+    return file.getSiblingFile(file.getFileNameWithoutExtension() + " - " + name + file.getFileExtension());
+}
+
+void RendererThread::startRecording(const File &file, const RenderFormat &renderFormat, Mode mode)
 {
     this->transport.rebuildSequencesIfNeeded();
-    const ProjectSequences sequences = this->transport.getSequences();
+    const ProjectSequences projectSequences = this->transport.getSequences();
     
-    if (sequences.empty())
+    if (projectSequences.empty())
     {
         return;
     }
 
     this->stop();
 
-    double sampleRate = sequences.getSampleRate();
-    int numChannels = sequences.getNumOutputChannels();
+    const double sampleRate = projectSequences.getSampleRate();
+    const int numChannels = projectSequences.getNumOutputChannels();
 
-    // Create an OutputStream to write to our destination file...
-    file.deleteFile();
-    ScopedPointer<FileOutputStream> fileStream(file.createOutputStream());
+    {
+        const ScopedWriteLock pl(this->percentsLock);
+        this->percentsDone = 0.f;
+    }
+    
+    {
+        const ScopedWriteLock rl(this->resultsLock);
+        this->results = RenderResults();
+    }
+    
+    this->format = renderFormat;
+    
+    const String extension = file.getFileExtension().toLowerCase();
 
-    if (fileStream != nullptr)
+    if (extension == ".wav")
     {
+        Supervisor::track(Serialization::Activities::transportRenderWav);
+    }
+    else if (extension == ".ogg")
+    {
+        Supervisor::track(Serialization::Activities::transportRenderOgg);
+    }
+    else if (extension == ".flac")
+    {
+        Supervisor::track(Serialization::Activities::transportRenderFlac);
+    }
+
+    if (mode == mixdown)
+    {
+        this->sequences = projectSequences;
+        
+        const ScopedLock sl(this->writerLock);
+        this->writer = createWriterFor(file, sampleRate, numChannels, renderFormat.bitsPerSample);
+        
+        if (this->writer == nullptr)
+        {
+            return;
+        }
+    }
+    else
+    {
+        StringArray stemNames;
+        
+        if (mode == trackStems)
         {
-            const ScopedWriteLock pl(this->percentsLock);
-            this->percentsDone = 0.f;
+            this->sequences = this->createTrackStemSequences(projectSequences, stemNames);
         }
+        else
+        {
+            this->sequences = projectSequences;
+            
+            for (auto instrument : this->sequences.getUniqueInstruments())
+            {
+                stemNames.add(instrument->getName());
+            }
+        }
+        
+        // stem writers go in the same order as the render buffers
+        const ScopedLock sl(this->writerLock);
+        StringArray usedNames;
         
-        if (file.getFileExtension().toLowerCase() == ".wav")
+        for (const auto &stemName : stemNames)
+        {
+            AudioFormatWriter *stemWriter =
+                createWriterFor(getStemFile(file, stemName, usedNames), sampleRate, numChannels, renderFormat.bitsPerSample);
+            
+            if (stemWriter == nullptr)
+            {
+                this->stemWriters.clear();
+                return;
+            }
+            
+            this->stemWriters.add(stemWriter);
+        }
+    }
+
+    // lossy formats have no bit depth to reduce to
+    const AudioFormatWriter *anyWriter = (this->writer != nullptr) ? this->writer.get() : this->stemWriters.getFirst();
+    const int bitsPerSample = (anyWriter != nullptr) ? anyWriter->getBitsPerSample() : 32;
+    const bool shouldDither = renderFormat.dither && extension != ".ogg" && bitsPerSample < 32;
+    this->ditherBits = shouldDither ? bitsPerSample : 0;
+
+    Logger::writeToLog(file.getFullPathName());
+    Supervisor::track(Serialization::Activities::transportStartRender);
+    this->startThread(9);
+}
+
+ProjectSequences RendererThread::createTrackStemSequences(const ProjectSequences &source, StringArray &outStemNames)
+{
+    ProjectSequences result;
+    HashMap<Instrument *, Array<Instrument *>> instancesForInstrument;
+    HashMap<const MidiSequence *, Instrument *> instanceForLayer;
+    const ReferenceCountedArray<SequenceWrapper> wrappers(source.getAllFor(nullptr));
+
+    auto hasNotes = [](const SequenceWrapper *wrapper)
+    {
+        for (int i = 0; i < wrapper->getNumEvents(); ++i)
         {
-            Supervisor::track(Serialization::Activities::transportRenderWav);
-            WavAudioFormat wavFormat;
-            const ScopedLock sl(this->writerLock);
-            this->writer = wavFormat.createWriterFor(fileStream, sampleRate, numChannels, 16, StringPairArray(), 0);
+            if (wrapper->getEvent(i).isNoteOn())
+            { return true; }
         }
-        else if (file.getFileExtension().toLowerCase() == ".ogg")
+
+        return false;
+    };
+
+    auto addWrapperFor = [&result](const SequenceWrapper *wrapper, Instrument *instrument)
+    {
+        auto trackWrapper = new SequenceWrapper();
+        trackWrapper->layer = wrapper->layer;
+        trackWrapper->midi = wrapper->midi;
+        trackWrapper->timeOffset = wrapper->timeOffset;
+        trackWrapper->instrument = instrument;
+        trackWrapper->listener = &instrument->getProcessorPlayer().getMidiMessageCollector();
+        result.addWrapper(trackWrapper);
+    };
+
+    // every track with notes gets its own instance of the instrument
+    for (auto wrapper : wrappers)
+    {
+        if (! hasNotes(wrapper))
+        { continue; }
+
+        // all clips of a track go to the same stem
+        if (instanceForLayer.contains(wrapper->layer))
         {
-            Supervisor::track(Serialization::Activities::transportRenderOgg);
-            OggVorbisAudioFormat oggVorbisFormat;
-            const ScopedLock sl(this->writerLock);
-            this->writer = oggVorbisFormat.createWriterFor(fileStream, sampleRate, numChannels, 16, StringPairArray(), 0);
+            addWrapperFor(wrapper, instanceForLayer[wrapper->layer]);
+            continue;
         }
-        else if (file.getFileExtension().toLowerCase() == ".flac")
+
+        Array<Instrument *> instances(instancesForInstrument[wrapper->instrument]);
+        Instrument *instance = wrapper->instrument;
+
+        if (instances.size() > 0)
         {
-            Supervisor::track(Serialization::Activities::transportRenderFlac);
-            FlacAudioFormat flacFormat;
-            const ScopedLock sl(this->writerLock);
-            this->writer = flacFormat.createWriterFor(fileStream, sampleRate, numChannels, 16, StringPairArray(), 0);
+            instance = this->instrumentCopies.add(wrapper->instrument->createCopy());
         }
 
-        if (writer != nullptr)
+        instances.add(instance);
+        instancesForInstrument.set(wrapper->instrument, instances);
+        instanceForLayer.set(wrapper->layer, instance);
+
+        addWrapperFor(wrapper, instance);
+        outStemNames.add(wrapper->layer->getTrack()->getTrackName());
+    }
+
+    // and the automation tracks go to all instances of their instrument
+    for (auto wrapper : wrappers)
+    {
+        if (hasNotes(wrapper))
+        { continue; }
+
+        for (auto instance : instancesForInstrument[wrapper->instrument])
         {
-            Logger::writeToLog(file.getFullPathName());
-            Supervisor::track(Serialization::Activities::transportStartRender);
-            fileStream.release(); // (passes responsibility for deleting the stream to the writer object that is now using it)
-            this->startThread(9);
+            addWrapperFor(wrapper, instance);
         }
     }
+
+    return result;
 }
 
 void RendererThread::stop()
@@ -114,7 +321,11 @@ void RendererThread::stop()
     {
         const ScopedLock sl(this->writerLock);
         this->writer = nullptr;
+        this->stemWriters.clear();
     }
+    
+    this->sequences.clear();
+    this->instrumentCopies.clear();
 }
 
 bool RendererThread::isRecording() const
@@ -123,6 +334,18 @@ bool RendererThread::isRecording() const
     return this->isThreadRunning();
 }
 
+RenderResults RendererThread::getResults() const
+{
+    const ScopedReadLock lock(this->resultsLock);
+    return this->results;
+}
+
+void RendererThread::setNumWorkers(int numWorkers)
+{
+    jassert(! this->isThreadRunning());
+    this->numWorkers = numWorkers;
+}
+
 
 //===----------------------------------------------------------------------===//
 // Thread
@@ -135,13 +358,35 @@ struct RenderBuffer
     MidiBuffer midiBuffer;
 };
 
+// The graphs are independent during a non-realtime bounce,
+// so every instrument's block is rendered as a separate job
+struct RenderJobs : public AudioWorkerPool::Client
+{
+    OwnedArray<RenderBuffer> subBuffers;
+
+    void processJob(int jobIndex) override
+    {
+        RenderBuffer *subBuffer = this->subBuffers.getUnchecked(jobIndex);
+        AudioProcessorGraph *graph = subBuffer->instrument->getProcessorGraph();
+
+        {
+            const ScopedLock lock(graph->getCallbackLock());
+            graph->processBlock(subBuffer->sampleBuffer, subBuffer->midiBuffer);
+        }
+
+        // the graph leaves its output events here
+        subBuffer->midiBuffer.clear();
+    }
+};
+
 void RendererThread::run()
 {
     // step 0. init.
-    this->transport.rebuildSequencesIfNeeded();
-    ProjectSequences sequences = this->transport.getSequences();
-    const int bufferSize = 512;
-    const double TPQN = Transport::millisecondsPerBeat; // ticks-per-quarter-note
+    ProjectSequences sequences(this->sequences);
+    
+    const String blockSizeSetting = Config::get(Serialization::Core::renderBlockSize);
+    const int bufferSize = blockSizeSetting.isEmpty() ?
+        RENDER_DEFAULT_BLOCK_SIZE : jlimit(32, 16384, blockSizeSetting.getIntValue());
 
     // assuming that number of channels and sample rate is equal for all instruments
     const int numOutChannels = sequences.getNumOutputChannels();
@@ -151,16 +396,12 @@ void RendererThread::run()
     double tempoAtTheEndOfTrack = 0.0;
     double totalTimeMs = 0.0;
     this->transport.calcTimeAndTempoAt(1.0, totalTimeMs, tempoAtTheEndOfTrack);
-    
-    // грязный хак. calcTimeAndTempoAt считает темп для PlayerThread'а немного по-другому,
-    // чем нужно здесь. поэтому TPQN заменяю на 1000.
-    // рефакторить лень.
-    // когда-нибудь у меня будет куча времени и я все сделаю по-человечески.
     const double lastFrame = totalTimeMs / 1000 * sampleRate;
 
 
     // step 1. create a list of unique instruments with audio buffers for them.
-    OwnedArray<RenderBuffer> subBuffers;
+    RenderJobs renderJobs;
+    OwnedArray<RenderBuffer> &subBuffers = renderJobs.subBuffers;
     Array<Instrument *> uniqueInstruments(sequences.getUniqueInstruments());
 
     for (int i = 0; i < uniqueInstruments.size(); ++i)
@@ -172,136 +413,219 @@ void RendererThread::run()
         subBuffers.add(subBuffer);
     }
 
-    // step 2. release resources, prepare to play, etc.
-    for (auto subBuffer : subBuffers)
-    {
-        AudioProcessorGraph *graph = subBuffer->instrument->getProcessorGraph();
-        graph->setPlayConfigDetails(numInChannels, numOutChannels, sampleRate, bufferSize);
-        graph->releaseResources();
-        graph->prepareToPlay(graph->getSampleRate(), bufferSize);
-        graph->setNonRealtime(true);
-    }
+    const TempoMap tempoMap(this->transport.getTempoMap());
 
-    // step 3. render loop itself.
-    double msPerTick = this->transport.findFirstTempoEvent().getTempoSecondsPerQuarterNote();
-    double currentFrame = 0.0;
+    OwnedArray<InstrumentMessages> instrumentMessages;
+    sequences.createInstrumentBuffers(instrumentMessages);
     
-    //double currentFrame = currentTimeMs / TPQN * sampleRate;
+    AudioSampleBuffer mixingBuffer(numOutChannels, bufferSize);
     
-    sequences.seekToTime(0.0);
+    AudioCore *audioCore = this->transport.audioCore;
+    const int numDefaultWorkers = (audioCore != nullptr) ?
+        audioCore->getNumAudioWorkers() : AudioWorkerPool::getDefaultNumWorkers();
     
-    MessageWrapper nextMessage;
-    bool hasNextMessage = sequences.getNextMessage(nextMessage);
-    jassert(hasNextMessage);
+    AudioWorkerPool workerPool((this->numWorkers < 0) ? numDefaultWorkers : this->numWorkers, 9);
     
-    AudioSampleBuffer mixingBuffer(numOutChannels, bufferSize);
+    ScopedPointer<AudioFormatWriter::ThreadedWriter> threadedWriter;
+    OwnedArray<AudioFormatWriter::ThreadedWriter> stemThreadedWriters;
     
-    double prevEventTimeStamp = 0.0;
-    double lastTick = 0.0;
-    double nextTickDelta = (nextMessage.message.getTimeStamp() - prevEventTimeStamp) * msPerTick / TPQN;
-    double nextEventTick = lastTick + nextTickDelta;
-
-    int messageFrame = int((nextEventTick * sampleRate) - currentFrame);
-
-    // And here we go: send MidiStart
-    for (auto subBuffer : subBuffers)
     {
-        subBuffer->midiBuffer.addEvent(MidiMessage::midiStart(), messageFrame);
+        const ScopedLock sl(this->writerLock);
+        
+        if (this->writer != nullptr)
+        {
+            threadedWriter = new AudioFormatWriter::ThreadedWriter(this->writer.release(),
+                this->writerThread, bufferSize * RENDER_NUM_BLOCKS_IN_WRITER_RING);
+        }
+        
+        jassert(this->stemWriters.size() == 0 || this->stemWriters.size() == subBuffers.size());
+        
+        while (this->stemWriters.size() > 0)
+        {
+            stemThreadedWriters.add(new AudioFormatWriter::ThreadedWriter(this->stemWriters.removeAndReturn(0),
+                this->writerThread, bufferSize * RENDER_NUM_BLOCKS_IN_WRITER_RING));
+        }
     }
-
-    while (currentFrame < lastFrame)
+    
+    this->writerThread.startThread(8);
+    
+    // waits only if the disk cannot keep up
+    auto writeBlock = [this, bufferSize](AudioFormatWriter::ThreadedWriter *target, const AudioSampleBuffer &buffer)
+    {
+        while (! target->write(buffer.getArrayOfReadPointers(), bufferSize))
+        {
+            if (this->threadShouldExit())
+            {
+                break;
+            }
+            
+            this->wait(1);
+        }
+    };
+    
+    // TPDF noise of one LSB of the target bit depth, added right before
+    // the writer quantizes the floats, decorrelates the rounding error
+    Random ditherRandom;
+    const float ditherLevel = (this->ditherBits > 0) ? (1.f / float((1 << (this->ditherBits - 1)) - 1)) : 0.f;
+    
+    auto addDither = [&ditherRandom, ditherLevel, bufferSize](AudioSampleBuffer &buffer)
     {
-        if (this->threadShouldExit())
+        for (int c = 0; c < buffer.getNumChannels(); ++c)
         {
-            break;
+            float *data = buffer.getWritePointer(c);
+            
+            for (int i = 0; i < bufferSize; ++i)
+            {
+                data[i] += (ditherRandom.nextFloat() - ditherRandom.nextFloat()) * ditherLevel;
+            }
         }
+    };
+    
+    // a pre-scan pass, if any, only measures the mix,
+    // so that the writing pass knows what gain to apply
+    const int numPasses = this->format.normalize ? 2 : 1;
+    LoudnessMeter meter;
+    float gainDb = 0.f;
+    
+    for (int pass = 0; pass < numPasses && ! this->threadShouldExit(); ++pass)
+    {
+        const bool isWritingPass = (pass == numPasses - 1);
+        const float gain = Decibels::decibelsToGain(gainDb);
         
-        // step 3a. fill up the midi buffers.
-        while (hasNextMessage &&
-               ( (nextEventTick * sampleRate) >= currentFrame &&
-                 (nextEventTick * sampleRate) < (currentFrame + bufferSize) ))
+        // step 2. release resources, prepare to play, etc.
+        for (auto subBuffer : subBuffers)
         {
-            messageFrame = int((nextEventTick * sampleRate) - currentFrame);
-
-            if (nextMessage.message.isTempoMetaEvent())
+            AudioProcessorGraph *graph = subBuffer->instrument->getProcessorGraph();
+            graph->setPlayConfigDetails(numInChannels, numOutChannels, sampleRate, bufferSize);
+            graph->releaseResources();
+            graph->prepareToPlay(graph->getSampleRate(), bufferSize);
+            graph->setNonRealtime(true);
+            subBuffer->midiBuffer.clear();
+        }
+        
+        meter.reset(sampleRate, numOutChannels);
+        
+        // step 3. render loop itself.
+        double currentFrame = 0.0;
+        
+        sequences.seekToTime(0.0);
+        jassert(sequences.hasNextMessage());
+        
+        // And here we go: send MidiStart
+        const int startFrame = jlimit(0, bufferSize - 1,
+            int(tempoMap.getTimeMsAt(sequences.getNextTimeStamp()) / 1000.0 * sampleRate));
+        
+        for (auto subBuffer : subBuffers)
+        {
+            subBuffer->midiBuffer.addEvent(MidiMessage::midiStart(), startFrame);
+        }
+        
+        while (currentFrame < lastFrame)
+        {
+            if (this->threadShouldExit())
             {
-                msPerTick = nextMessage.message.getTempoSecondsPerQuarterNote();
-
-                // Sends this to everybody (need to do that for drum-machines) - TODO test
-                for (auto subBuffer : subBuffers)
-                {
-                    subBuffer->midiBuffer.addEvent(nextMessage.message, messageFrame);
-                }
+                break;
             }
-            else
+            
+            // step 3a. fill up the midi buffers.
+            const double blockEndTimeStamp = tempoMap.getTimeStampAt((currentFrame + bufferSize) / sampleRate * 1000.0);
+            bool hasMoreMessages = true;
+            
+            while (hasMoreMessages)
             {
-                for (auto subBuffer : subBuffers)
+                // tempo changes are already in the tempo map, so just keep on reading
+                hasMoreMessages = sequences.drainMessagesUntil(blockEndTimeStamp, instrumentMessages);
+                
+                for (int i = 0; i < instrumentMessages.size(); ++i)
                 {
-                    if (nextMessage.instrument == subBuffer->instrument)
+                    Array<MidiMessage> &messages = instrumentMessages.getUnchecked(i)->messages;
+                    RenderBuffer *subBuffer = subBuffers.getUnchecked(i);
+                    
+                    for (const auto &message : messages)
                     {
+                        const double messageFrame = tempoMap.getTimeMsAt(message.getTimeStamp()) / 1000.0 * sampleRate;
                         //Logger::writeToLog("Adding message with frame " + String(messageFrame));
-                        subBuffer->midiBuffer.addEvent(nextMessage.message, messageFrame);
+                        subBuffer->midiBuffer.addEvent(message,
+                            jlimit(0, bufferSize - 1, int(messageFrame - currentFrame)));
                     }
+                    
+                    messages.clearQuick();
                 }
             }
-
-            lastTick += nextTickDelta;
-            prevEventTimeStamp = nextMessage.message.getTimeStamp();
             
-            hasNextMessage = sequences.getNextMessage(nextMessage);
-            nextTickDelta = (nextMessage.message.getTimeStamp() - prevEventTimeStamp) * msPerTick / TPQN;
-            nextEventTick = lastTick + nextTickDelta;
-        }
-
-        // step 3b. call processBlock for every instrument.
-        for (auto subBuffer : subBuffers)
-        {
-            AudioProcessorGraph *graph = subBuffer->instrument->getProcessorGraph();
+            // step 3b. call processBlock for every instrument, in parallel.
+            workerPool.processJobs(renderJobs, subBuffers.size());
+            
+            // step 3c. mix them down to the render buffer, and measure the mix,
+            // even if only the stems are written.
+            mixingBuffer.clear();
+            
+            for (auto subBuffer : subBuffers)
             {
-                const ScopedLock lock(graph->getCallbackLock());
+                if (gain != 1.f)
+                {
+                    subBuffer->sampleBuffer.applyGain(0, bufferSize, gain);
+                }
                 
-                //Logger::writeToLog("processBlock num midi events: " + String(subBuffers[i]->midiBuffer.getNumEvents()));
-                graph->processBlock(subBuffer->sampleBuffer, subBuffer->midiBuffer);
+                for (int j = 0; j < numOutChannels; ++j)
+                {
+                    mixingBuffer.addFrom(j, 0,
+                        subBuffer->sampleBuffer, j, 0,
+                        bufferSize,
+                        1.0f);
+                }
+            }
+            
+            meter.process(mixingBuffer, bufferSize);
+            
+            // step 3d. pass resulting buffers to the writer thread.
+            if (isWritingPass)
+            {
+                if (threadedWriter != nullptr)
+                {
+                    if (ditherLevel > 0.f) { addDither(mixingBuffer); }
+                    writeBlock(threadedWriter, mixingBuffer);
+                }
                 
-                // TODO test if I ever need this hack
-                //Thread::sleep(15);
+                // stems are written as they are
+                for (int i = 0; i < stemThreadedWriters.size(); ++i)
+                {
+                    AudioSampleBuffer &stemBuffer = subBuffers.getUnchecked(i)->sampleBuffer;
+                    if (ditherLevel > 0.f) { addDither(stemBuffer); }
+                    writeBlock(stemThreadedWriters.getUnchecked(i), stemBuffer);
+                }
             }
-        }
-
-        // step 3c. mix them down to the render buffer.
-        mixingBuffer.clear();
-
-        for (auto subBuffer : subBuffers)
-        {
-            for (int j = 0; j < numOutChannels; ++j)
+            
+            // step 3e. finally, update counters.
+            currentFrame += bufferSize;
+            
             {
-                mixingBuffer.addFrom(j, 0,
-                    subBuffer->sampleBuffer, j, 0,
-                    bufferSize,
-                    1.0f); // need to calc gain?
+                const ScopedWriteLock pl(this->percentsLock);
+                this->percentsDone = float((pass + currentFrame / lastFrame) / numPasses);
+                //Logger::writeToLog("this->percentsDone : " + String(this->percentsDone));
             }
         }
-
-        // step 3d. write resulting buffer to disk.
+        
+        if (! isWritingPass)
         {
-            const ScopedLock sl(this->writerLock);
-            bool writedSuccessfullty = false;
+            // fit the loudness into the target, unless the peaks get above the ceiling
+            const float loudness = meter.getIntegratedLoudness();
+            const float truePeak = meter.getTruePeak();
             
-            while (! writedSuccessfullty)
+            if (loudness > LOUDNESS_MINUS_INFINITY)
             {
-                writedSuccessfullty =
-                this->writer->writeFromAudioSampleBuffer(mixingBuffer, 0, mixingBuffer.getNumSamples());
+                gainDb = jmin(this->format.targetLoudness - loudness,
+                              this->format.truePeakCeiling - truePeak);
             }
         }
-
-        // step 3e. finally, update counters.
-        currentFrame += bufferSize;
-
-        {
-            const ScopedWriteLock pl(this->percentsLock);
-            this->percentsDone = float(currentFrame / lastFrame);
-            //Logger::writeToLog("this->percentsDone : " + String(this->percentsDone));
-        }
+    }
+    
+    {
+        const ScopedWriteLock rl(this->resultsLock);
+        this->results.samplePeak = meter.getSamplePeak();
+        this->results.truePeak = meter.getTruePeak();
+        this->results.loudness = meter.getIntegratedLoudness();
+        this->results.gain = gainDb;
     }
 
     // step 4. setNonRealtime false.
@@ -311,17 +635,22 @@ void RendererThread::run()
         graph->setNonRealtime(false);
     }
     
-    {
-        const ScopedLock sl(this->writerLock);
-        this->writer = nullptr;
-    }
+    // flushes all pending data and closes the files
+    threadedWriter = nullptr;
+    stemThreadedWriters.clear();
+    this->writerThread.stopThread(500);
     
     Supervisor::track(Serialization::Activities::transportFinishRender);
     
     if (! this->threadShouldExit())
+    {
+        Logger::writeToLog("Rendered: " + this->getResults().toString());
+    }
+    
+    if (! this->threadShouldExit() && audioCore != nullptr)
     {
         // dirty hack
-        App::Workspace().getAudioCore().unmute();
-        App::Workspace().getAudioCore().unmute();
+        audioCore->unmute();
+        audioCore->unmute();
     }
 }
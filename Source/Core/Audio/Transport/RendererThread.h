@@ -18,6 +18,7 @@
 #pragma once
 
 #include "Transport.h"
+#include "RenderFormat.h"
 
 class RendererThread : private Thread
 {
@@ -27,14 +28,28 @@ public:
 
     ~RendererThread() override;
     
+    enum Mode
+    {
+        mixdown,
+        instrumentStems,    // a file per instrument
+        trackStems          // a file per track, instruments are copied if shared
+    };
+    
     float getPercentsComplete() const;
 
-    void startRecording(const File &file);
+    // Stems are named after the given file, like "Song - Piano.wav"
+    void startRecording(const File &file, const RenderFormat &renderFormat, Mode mode = mixdown);
 
     void stop();
 
     bool isRecording() const;
 
+    // Measured on the mix, filled in when the render is finished
+    RenderResults getResults() const;
+
+    // Defaults to the number of audio workers in the device callback
+    void setNumWorkers(int numWorkers);
+
 private:
 
     //===------------------------------------------------------------------===//
@@ -47,11 +62,28 @@ private:
 
     Transport &transport;
 
+    ProjectSequences sequences;
+    ProjectSequences createTrackStemSequences(const ProjectSequences &source, StringArray &outStemNames);
+    OwnedArray<Instrument> instrumentCopies;
+
     CriticalSection writerLock;
     ScopedPointer<AudioFormatWriter> writer;
+    OwnedArray<AudioFormatWriter> stemWriters; // one per unique instrument
+
+    // Encoding and disk writing are done here, so that
+    // the rendering never waits for the disk
+    TimeSliceThread writerThread;
 
     ReadWriteLock percentsLock;
     float percentsDone;
+
+    RenderFormat format;
+    int ditherBits; // 0 if no dither is needed
+
+    ReadWriteLock resultsLock;
+    RenderResults results;
+
+    int numWorkers;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RendererThread)
 };
@@ -0,0 +1,184 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// An immutable piecewise table of tempo changes.
+// Each segment keeps its starting timestamp, the tempo (ms per tick) and
+// the real time in milliseconds accumulated up to that timestamp,
+// so that any conversion is a binary search plus interpolation.
+// Tempo before the first tempo event is equal to the tempo at that event.
+
+class TempoMap
+{
+public:
+
+    TempoMap() :
+        defaultMsPerTick(0.5),
+        firstTempoEvent(MidiMessage::tempoMetaEvent(500000)) {}
+
+    TempoMap(const MidiMessageSequence &sequence,
+             double ticksPerQuarterNote,
+             double defaultTempo) :
+        defaultMsPerTick(defaultTempo),
+        firstTempoEvent(MidiMessage::tempoMetaEvent(int(ticksPerQuarterNote * 1000)))
+    {
+        bool foundFirstTempoEvent = false;
+
+        for (int i = 0; i < sequence.getNumEvents(); ++i)
+        {
+            const MidiMessage &message = sequence.getEventPointer(i)->message;
+
+            if (! message.isTempoMetaEvent())
+            { continue; }
+
+            if (! foundFirstTempoEvent)
+            {
+                this->firstTempoEvent = message;
+                foundFirstTempoEvent = true;
+            }
+
+            const double msPerTick = message.getTempoSecondsPerQuarterNote() * 1000.0 / ticksPerQuarterNote;
+
+            if (this->segments.size() == 0)
+            {
+                const Segment first = { message.getTimeStamp(), message.getTimeStamp() * msPerTick, msPerTick };
+                this->segments.add(first);
+                continue;
+            }
+
+            const Segment &last = this->segments.getReference(this->segments.size() - 1);
+            const double timeMs = last.timeMs + last.msPerTick * (message.getTimeStamp() - last.timeStamp);
+            const Segment next = { message.getTimeStamp(), timeMs, msPerTick };
+
+            // several tempo events at the same timestamp: the last one wins
+            if (last.timeStamp == next.timeStamp)
+            {
+                this->segments.setUnchecked(this->segments.size() - 1, next);
+            }
+            else
+            {
+                this->segments.add(next);
+            }
+        }
+    }
+
+    void swapWith(TempoMap &other) noexcept
+    {
+        this->segments.swapWith(other.segments);
+        std::swap(this->defaultMsPerTick, other.defaultMsPerTick);
+        std::swap(this->firstTempoEvent, other.firstTempoEvent);
+    }
+
+    bool isEmpty() const noexcept
+    {
+        return (this->segments.size() == 0);
+    }
+
+    MidiMessage getFirstTempoEvent() const noexcept
+    {
+        return this->firstTempoEvent;
+    }
+
+    double getTempoAt(double timeStamp) const noexcept
+    {
+        if (this->isEmpty())
+        { return this->defaultMsPerTick; }
+
+        return this->segments.getReference(this->findSegmentByTimeStamp(timeStamp)).msPerTick;
+    }
+
+    double getTimeMsAt(double timeStamp) const noexcept
+    {
+        if (this->isEmpty())
+        { return this->defaultMsPerTick * timeStamp; }
+
+        const Segment &s = this->segments.getReference(this->findSegmentByTimeStamp(timeStamp));
+        return s.timeMs + s.msPerTick * (timeStamp - s.timeStamp);
+    }
+
+    double getTimeStampAt(double timeMs) const noexcept
+    {
+        if (this->isEmpty())
+        { return timeMs / this->defaultMsPerTick; }
+
+        const Segment &s = this->segments.getReference(this->findSegmentByTimeMs(timeMs));
+        return s.timeStamp + (timeMs - s.timeMs) / s.msPerTick;
+    }
+
+private:
+
+    struct Segment
+    {
+        double timeStamp;
+        double timeMs;
+        double msPerTick;
+    };
+
+    Array<Segment> segments;
+
+    double defaultMsPerTick;
+    MidiMessage firstTempoEvent;
+
+    // Index of the last segment starting at or before the given point,
+    // or the first one, if the point is before all segments
+    int findSegmentByTimeStamp(double timeStamp) const noexcept
+    {
+        int first = 0;
+        int last = this->segments.size();
+
+        while (last - first > 1)
+        {
+            const int middle = (first + last) / 2;
+
+            if (this->segments.getReference(middle).timeStamp <= timeStamp)
+            {
+                first = middle;
+            }
+            else
+            {
+                last = middle;
+            }
+        }
+
+        return first;
+    }
+
+    int findSegmentByTimeMs(double timeMs) const noexcept
+    {
+        int first = 0;
+        int last = this->segments.size();
+
+        while (last - first > 1)
+        {
+            const int middle = (first + last) / 2;
+
+            if (this->segments.getReference(middle).timeMs <= timeMs)
+            {
+                first = middle;
+            }
+            else
+            {
+                last = middle;
+            }
+        }
+
+        return first;
+    }
+
+    JUCE_LEAK_DETECTOR(TempoMap)
+};
@@ -21,13 +21,15 @@
 #include "OrchestraPit.h"
 #include "PlayerThread.h"
 #include "RendererThread.h"
+#include "PlaybackScheduler.h"
 #include "MidiSequence.h"
 #include "MidiEvent.h"
 #include "MidiTrack.h"
-#include "App.h"
-#include "Workspace.h"
+#include "Pattern.h"
 #include "AudioCore.h"
 #include "HybridRoll.h"
+#include "SerializationKeys.h"
+#include "Config.h"
 
 #if PLAYER_THREAD_SENDS_SEEK_EVENTS
 #   define PLAYER_THREAD_STOP_TIME_MS 1500
@@ -35,21 +37,39 @@
 #   define PLAYER_THREAD_STOP_TIME_MS 100
 #endif
 
+#define SCHEDULER_UPDATE_TIME_MS 35
+
+Transport::Transport(AudioCore &audioCore) :
+    Transport(static_cast<OrchestraPit &>(audioCore))
+{
+    this->audioCore = &audioCore;
+    this->blockBasedPlayback =
+        (Config::get(Serialization::Core::blockBasedPlayback) != Serialization::Core::disabledState);
+}
+
 Transport::Transport(OrchestraPit &orchestraPit) :
     orchestra(orchestraPit),
+    audioCore(nullptr),
     seekPosition(0.0),
     trackStartMs(0.0),
     trackEndMs(0.0),
     sequencesAreOutdated(true),
+    tempoMapIsOutdated(true),
+    pendingSequences(nullptr),
+    pendingTimeShift(0.0),
     totalTime(Transport::millisecondsPerBeat * 8),
     loopedMode(false),
     loopStart(0.0),
     loopEnd(0.0),
     projectFirstBeat(0.f),
-    projectLastBeat(DEFAULT_NUM_BARS * NUM_BEATS_IN_BAR)
+    projectLastBeat(DEFAULT_NUM_BARS * NUM_BEATS_IN_BAR),
+    schedulerIsAttached(false),
+    lastBroadcastTempo(0.0)
 {
     this->player = new PlayerThread(*this);
     this->renderer = new RendererThread(*this);
+    this->scheduler = new PlaybackScheduler(*this);
+    this->blockBasedPlayback = false;
 
     this->orchestra.addOrchestraListener(this);
 }
@@ -57,12 +77,20 @@ Transport::Transport(OrchestraPit &orchestraPit) :
 Transport::~Transport()
 {
     this->orchestra.removeOrchestraListener(this);
+    this->cancelPendingUpdate();
     
     if (this->player->isThreadRunning())
     {
         this->player->stopThread(500);
     }
     
+    if (this->schedulerIsAttached)
+    {
+        this->detachScheduler();
+    }
+    
+    this->discardPendingSequences();
+    
     if (this->renderer->isRecording())
     {
         this->renderer->stop();
@@ -155,9 +183,40 @@ void Transport::setTotalTime(const double val)
 
 void Transport::rebuildSequencesInRealtime()
 {
-    // todo sequences write lock
-    //this->rebuildSequencesIfNeeded();
-    //this->sequences.seekToTime(this->lastSeekTimeStamp);
+    this->rebuildSequencesIfNeeded();
+    
+    if (this->isPlaying())
+    {
+        if (this->schedulerIsAttached)
+        {
+            delete this->scheduler->takeRetiredSequences();
+        }
+        
+        // if the player didn't pick up the previous copy yet, it's not needed anymore,
+        // but the listeners it has changed are still to be reset
+        ScopedPointer<PendingSequences> stale(this->pendingSequences.exchange(nullptr));
+
+        // all the allocations happen here, so that the realtime scheduler
+        // only has to swap the pointers at its next block boundary
+        ScopedPointer<PendingSequences> pending(new PendingSequences());
+        pending->sequences = new ProjectSequences(this->sequences);
+        pending->sequences->createInstrumentBuffers(pending->instrumentMessages,
+                                                    PlaybackScheduler::numReservedEvents);
+        pending->changedListeners = this->sequences.getListenersChangedSince(this->publishedSequences);
+        pending->timeShift = this->pendingTimeShift;
+        pending->tempoMap = this->getTempoMap();
+        this->calcPlaybackRange(pending->startTimeStamp, pending->endTimeStamp);
+
+        if (stale != nullptr)
+        {
+            pending->changedListeners.addArray(stale->changedListeners);
+            pending->timeShift += stale->timeShift;
+        }
+
+        this->publishedSequences = this->sequences;
+        this->pendingTimeShift = 0.0;
+        this->pendingSequences = pending.release();
+    }
 }
 
 void Transport::seekToPosition(double absPosition)
@@ -184,21 +243,33 @@ void Transport::probeSoundAt(double absTrackPosition, const MidiSequence *limitT
     {
         SequenceWrapper::Ptr seq(i);
 
-        for (int j = 0; j < seq->sequence.getNumEvents(); ++j)
+        // the notes which are still on at the target time are the ones
+        // whose last note-on has no note-off up to that time
+        HeapBlock<int> soundingNotes(16 * 128, true);
+
+        const int numEventsBefore = seq->getNextIndexAfterTime(targetFlatTime);
+
+        for (int j = 0; j < numEventsBefore; ++j)
         {
-            MidiMessageSequence::MidiEventHolder *noteOnHolder = seq->sequence.getEventPointer(j);
-            
-            if (MidiMessageSequence::MidiEventHolder *noteOffHolder = noteOnHolder->noteOffObject)
+            const MidiMessage &message = seq->getEvent(j);
+
+            if (message.isNoteOn())
             {
-                const double noteOn(noteOnHolder->message.getTimeStamp());
-                const double noteOff(noteOffHolder->message.getTimeStamp());
-                
-                if (noteOn <= targetFlatTime && noteOff > targetFlatTime)
-                {
-                    MidiMessage messageTimestampedAsNow(noteOnHolder->message);
-                    messageTimestampedAsNow.setTimeStamp(Time::getMillisecondCounterHiRes() * 0.001);
-                    seq->listener->addMessageToQueue(messageTimestampedAsNow);
-                }
+                soundingNotes[(message.getChannel() - 1) * 128 + message.getNoteNumber()] = j + 1;
+            }
+            else if (message.isNoteOff())
+            {
+                soundingNotes[(message.getChannel() - 1) * 128 + message.getNoteNumber()] = 0;
+            }
+        }
+
+        for (int k = 0; k < 16 * 128; ++k)
+        {
+            if (soundingNotes[k] > 0)
+            {
+                MidiMessage messageTimestampedAsNow(seq->getEvent(soundingNotes[k] - 1));
+                messageTimestampedAsNow.setTimeStamp(Time::getMillisecondCounterHiRes() * 0.001);
+                seq->listener->addMessageToQueue(messageTimestampedAsNow);
             }
         }
     }
@@ -207,46 +278,51 @@ void Transport::probeSoundAt(double absTrackPosition, const MidiSequence *limitT
 void Transport::startPlayback()
 {
     this->rebuildSequencesIfNeeded();
-
-    if (this->player->isThreadRunning() &&
-        !this->player->threadShouldExit())
-    {
-        this->player->stopThread(PLAYER_THREAD_STOP_TIME_MS);
-        this->allNotesControllersAndSoundOff();
-    }
+    this->interruptPlayback();
     
     this->loopedMode = false;
+    this->discardPendingSequences();
+    
+    if (this->blockBasedPlayback)
+    {
+        this->attachScheduler();
+    }
+    else
+    {
+        this->player->startThread(10);
+    }
     
-    this->player->startThread(10);
     this->broadcastPlay();
 }
 
 void Transport::startPlaybackLooped(double absLoopStart, double absLoopEnd)
 {
     this->rebuildSequencesIfNeeded();
-    
-    if (this->player->isThreadRunning() &&
-        !this->player->threadShouldExit())
-    {
-        this->player->stopThread(PLAYER_THREAD_STOP_TIME_MS);
-        this->allNotesControllersAndSoundOff();
-    }
+    this->interruptPlayback();
     
     this->loopedMode = true;
     this->loopStart = jmax(0.0, absLoopStart);
     this->loopEnd = jmin(1.0, absLoopEnd);
+    this->discardPendingSequences();
+    
+    if (this->blockBasedPlayback)
+    {
+        this->attachScheduler();
+    }
+    else
+    {
+        this->player->startThread(10);
+    }
     
-    this->player->startThread(10);
     this->broadcastPlay();
 }
 
 void Transport::stopPlayback()
 {
-    if (this->player->isThreadRunning() &&
-        !this->player->threadShouldExit())
+    if (this->schedulerIsAttached ||
+        (this->player->isThreadRunning() && !this->player->threadShouldExit()))
     {
-        this->player->stopThread(PLAYER_THREAD_STOP_TIME_MS);
-        this->allNotesControllersAndSoundOff();
+        this->interruptPlayback();
         this->loopedMode = false;
         this->seekToPosition(this->getSeekPosition());
         this->broadcastStop();
@@ -260,7 +336,7 @@ void Transport::toggleStatStopPlayback()
 
 bool Transport::isPlaying() const
 {
-    return this->player->isThreadRunning();
+    return this->schedulerIsAttached || this->player->isThreadRunning();
 }
 
 bool Transport::isLooped() const
@@ -279,17 +355,147 @@ double Transport::getLoopEnd() const
 }
 
 
+//===----------------------------------------------------------------------===//
+// Block-based playback
+//===----------------------------------------------------------------------===//
+
+void Transport::interruptPlayback()
+{
+    if (this->player->isThreadRunning() &&
+        !this->player->threadShouldExit())
+    {
+        this->player->stopThread(PLAYER_THREAD_STOP_TIME_MS);
+        this->allNotesControllersAndSoundOff();
+    }
+    
+    if (this->schedulerIsAttached)
+    {
+        this->detachScheduler();
+        this->allNotesControllersAndSoundOff();
+    }
+}
+
+void Transport::calcPlaybackRange(double &outStartTimeStamp, double &outEndTimeStamp) const
+{
+    const double absStartPosition = this->loopedMode ? this->loopStart : this->getSeekPosition();
+    const double absEndPosition = this->loopedMode ? this->loopEnd : 1.0;
+
+    outStartTimeStamp = round(absStartPosition * this->getTotalTime());
+    outEndTimeStamp = round(absEndPosition * this->getTotalTime());
+}
+
+double Transport::getPlayheadTimeStamp() const
+{
+    return this->schedulerIsAttached ?
+        this->scheduler->getCurrentTimeStamp() :
+        this->player->getCurrentTimeStamp();
+}
+
+void Transport::attachScheduler()
+{
+    double startTimeStamp = 0.0;
+    double endTimeStamp = 0.0;
+    this->calcPlaybackRange(startTimeStamp, endTimeStamp);
+    
+    this->publishedSequences = this->sequences;
+    this->scheduler->prepare(this->sequences,
+                             this->getTempoMap(),
+                             startTimeStamp,
+                             endTimeStamp,
+                             this->loopedMode);
+    
+    this->lastBroadcastTempo = this->scheduler->getCurrentTempo();
+    this->broadcastTempoChanged(this->lastBroadcastTempo);
+    
+    this->audioCore->setPlaybackScheduler(this->scheduler);
+    this->schedulerIsAttached = true;
+    this->startTimer(SCHEDULER_UPDATE_TIME_MS);
+}
+
+void Transport::detachScheduler()
+{
+    this->stopTimer();
+    
+    // after this returns, the audio thread is done with the scheduler
+    this->audioCore->setPlaybackScheduler(nullptr);
+    this->schedulerIsAttached = false;
+    
+    this->scheduler->sendHoldingNotesOffAndMidiStop();
+    delete this->scheduler->takeRetiredSequences();
+}
+
+void Transport::timerCallback()
+{
+    delete this->scheduler->takeRetiredSequences();
+    
+    double totalTimeMs = 0.0;
+    double tempoAtTheEndOfTrack = 0.0;
+    this->calcTimeAndTempoAt(1.0, totalTimeMs, tempoAtTheEndOfTrack);
+    
+    this->broadcastSeek(this->scheduler->getCurrentTimeStamp() / this->getTotalTime(),
+                        this->scheduler->getCurrentTimeMs(),
+                        totalTimeMs);
+    
+    const double tempo = this->scheduler->getCurrentTempo();
+    
+    if (this->lastBroadcastTempo != tempo)
+    {
+        this->lastBroadcastTempo = tempo;
+        this->broadcastTempoChanged(tempo);
+    }
+    
+    if (this->scheduler->hasFinished())
+    {
+        this->detachScheduler();
+        this->allNotesControllersAndSoundOff();
+        this->seekToPosition(this->getSeekPosition());
+        this->broadcastStop();
+    }
+}
+
+
 void Transport::startRender(const String &fileName)
+{
+    this->startRender(fileName, RenderFormat::fromConfig());
+}
+
+void Transport::startRender(const String &fileName, const RenderFormat &format)
 {
     if (this->renderer->isRecording())
     {
         return;
     }
     
-    App::Workspace().getAudioCore().mute();
+    if (this->audioCore != nullptr)
+    {
+        this->audioCore->mute();
+    }
     
     File file(File::getCurrentWorkingDirectory().getChildFile(fileName));
-    this->renderer->startRecording(file);
+    this->renderer->startRecording(file, format);
+}
+
+void Transport::startStemsRender(const String &fileName, bool splitByTracks)
+{
+    this->startStemsRender(fileName, splitByTracks, RenderFormat::fromConfig());
+}
+
+void Transport::startStemsRender(const String &fileName, bool splitByTracks, const RenderFormat &format)
+{
+    if (this->renderer->isRecording())
+    {
+        return;
+    }
+    
+    if (this->audioCore != nullptr)
+    {
+        this->audioCore->mute();
+    }
+    
+    File file(File::getCurrentWorkingDirectory().getChildFile(fileName));
+    this->renderer->startRecording(file, format, splitByTracks ?
+                                   RendererThread::trackStems :
+                                   RendererThread::instrumentStems);
 }
 
 void Transport::stopRender()
@@ -301,10 +507,18 @@ void Transport::stopRender()
     
     this->renderer->stop();
     
-    // a dirty hack
-    App::Workspace().getAudioCore().unmute();
-    //this->allNotesControllersAndSoundOff();
-    App::Workspace().getAudioCore().unmute();
+    if (this->audioCore != nullptr)
+    {
+        // a dirty hack
+        this->audioCore->unmute();
+        //this->allNotesControllersAndSoundOff();
+        this->audioCore->unmute();
+    }
+}
+
+void Transport::setNumRenderWorkers(int numWorkers)
+{
+    this->renderer->setNumWorkers(numWorkers);
 }
 
 bool Transport::isRendering() const
@@ -317,6 +531,11 @@ float Transport::getRenderingPercentsComplete() const
     return this->renderer->getPercentsComplete();
 }
 
+RenderResults Transport::getRenderResults() const
+{
+    return this->renderer->getResults();
+}
+
 
 //===----------------------------------------------------------------------===//
 // Sending messages at real-time
@@ -439,80 +658,119 @@ void Transport::instrumentRemovedPostAction()
 
 void Transport::onChangeMidiEvent(const MidiEvent &oldEvent, const MidiEvent &newEvent)
 {
-    // todo stop playback only if the event is in future and getControllerNumber == 0 (not an automation)
-    
-    if (this->player->isThreadRunning())
-    { this->stopPlayback(); }
-    
-    // a hack
+    // tempo changes affect the timing of everything else
     if (newEvent.getControllerNumber() == MidiTrack::tempoController)
     {
+        if (this->isPlaying())
+        { this->stopPlayback(); }
+        
+        // a hack
+        this->tempoMapIsOutdated = true;
         this->seekToPosition(this->getSeekPosition());
     }
     
-    this->sequencesAreOutdated = true;
+    this->invalidateLayer(newEvent.getSequence());
 }
 
 void Transport::onAddMidiEvent(const MidiEvent &event)
 {
-    // todo stop playback only if the event is in future and getControllerNumber == 0 (not an automation)
-
-    if (this->player->isThreadRunning())
-    { this->stopPlayback(); }
-    
-    // a hack
     if (event.getControllerNumber() == MidiTrack::tempoController)
     {
+        if (this->isPlaying())
+        { this->stopPlayback(); }
+        
+        // a hack
+        this->tempoMapIsOutdated = true;
         this->seekToPosition(this->getSeekPosition());
     }
     
-    this->sequencesAreOutdated = true;
+    this->invalidateLayer(event.getSequence());
 }
 
 void Transport::onRemoveMidiEvent(const MidiEvent &event)
 {
-    // todo stop playback only if the event is in future and getControllerNumber == 0 (not an automation)
-
-    if (this->player->isThreadRunning())
-    { this->stopPlayback(); }
+    if (event.getControllerNumber() == MidiTrack::tempoController)
+    {
+        if (this->isPlaying())
+        { this->stopPlayback(); }
+        
+        this->tempoMapIsOutdated = true;
+    }
     
-    this->sequencesAreOutdated = true;
+    this->invalidateLayer(event.getSequence());
 }
 
 void Transport::onPostRemoveMidiEvent(MidiSequence *const layer)
 {
-    if (this->player->isThreadRunning())
-    { this->stopPlayback(); }
-    
     // a hack to re-calculate length and current time
     if (layer->getTrack()->getTrackControllerNumber() == MidiTrack::tempoController)
     {
+        if (this->isPlaying())
+        { this->stopPlayback(); }
+        
+        this->tempoMapIsOutdated = true;
         this->seekToPosition(this->getSeekPosition());
     }
     
-    this->sequencesAreOutdated = true;
+    this->invalidateLayer(layer);
+}
+
+void Transport::onAddClip(const Clip &clip)
+{
+    this->invalidateClips(clip.getPattern());
+}
+
+void Transport::onChangeClip(const Clip &oldClip, const Clip &newClip)
+{
+    this->invalidateClips(newClip.getPattern());
+}
+
+void Transport::onRemoveClip(const Clip &clip)
+{
+    this->invalidateClips(clip.getPattern());
+}
+
+void Transport::onPostRemoveClip(Pattern *const pattern)
+{
+    this->invalidateClips(pattern);
 }
 
 void Transport::onChangeTrackProperties(MidiTrack *const track)
 {
     // TODO: stop playback only when instrument changes?
-    this->onResetTrackContent(track);
+    if (this->isPlaying())
+    { this->stopPlayback(); }
+    
+    // the track might have been muted or turned into a tempo track
+    this->tempoMapIsOutdated = true;
+    this->sequencesAreOutdated = true;
+    this->updateLinkForTrack(track);
 }
 
 void Transport::onResetTrackContent(MidiTrack *const track)
 {
-    if (this->player->isThreadRunning())
-    { this->stopPlayback(); }
-
-    this->sequencesAreOutdated = true;
+    const String trackId = track->getTrackId().toString();
+    Instrument *const lastInstrument = this->linksCache[trackId];
     this->updateLinkForTrack(track);
+    
+    if (track->isTempoTrack() ||
+        lastInstrument != this->linksCache[trackId])
+    {
+        this->onChangeTrackProperties(track);
+        return;
+    }
+    
+    this->invalidateLayer(track->getSequence());
 }
 
 void Transport::onAddTrack(MidiTrack *const track)
 {
-    if (this->player->isThreadRunning())
+    if (this->isPlaying())
     {this->stopPlayback(); }
     
+    if (track->isTempoTrack())
+    { this->tempoMapIsOutdated = true; }
+    
     this->sequencesAreOutdated = true;
     this->tracksCache.addIfNotAlreadyThere(track);
     this->updateLinkForTrack(track);
@@ -520,9 +778,12 @@ void Transport::onAddTrack(MidiTrack *const track)
 
 void Transport::onRemoveTrack(MidiTrack *const track)
 {
-    if (this->player->isThreadRunning())
+    if (this->isPlaying())
     {this->stopPlayback(); }
     
+    if (track->isTempoTrack())
+    { this->tempoMapIsOutdated = true; }
+    
     this->sequencesAreOutdated = true;
     this->tracksCache.removeAllInstancesOf(track);
     this->removeLinkForTrack(track);
@@ -530,16 +791,36 @@ void Transport::onRemoveTrack(MidiTrack *const track)
 
 void Transport::onChangeProjectBeatRange(float firstBeat, float lastBeat)
 {
-    if (this->player->isThreadRunning())
+    const double oldBeatRange = (this->projectLastBeat - this->projectFirstBeat);
+    const double newBeatRange = (lastBeat - firstBeat); // may also be 0
+
+    auto getNewPosition = [&](double oldPosition)
+    {
+        const double beat = this->projectFirstBeat + oldBeatRange * oldPosition; // may be 0
+        return (newBeatRange == 0.0) ? 0.0 : ((beat - firstBeat) / newBeatRange);
+    };
+
+    // the playback goes on within the new range,
+    // unless the playhead or the loop are out of it now
+    if (this->isPlaying())
     {
-        this->stopPlayback();
+        const double playheadBeat = (this->trackStartMs + this->getPlayheadTimeStamp()) / Transport::millisecondsPerBeat;
+        bool isOutOfRange = (playheadBeat < firstBeat || playheadBeat > lastBeat);
+
+        if (this->loopedMode)
+        {
+            isOutOfRange = isOutOfRange ||
+                getNewPosition(this->loopStart) < 0.0 ||
+                getNewPosition(this->loopEnd) > 1.0;
+        }
+
+        if (isOutOfRange)
+        {
+            this->stopPlayback();
+        }
     }
     
-    const double lastSeekPosition = float(this->getSeekPosition());
-    const double seekBeat = this->projectFirstBeat + ((this->projectLastBeat - this->projectFirstBeat) * lastSeekPosition); // may be 0
-    //const double roundSeekBeat = round(seekBeat * 1000.0) / 1000.0;
-    const double newBeatRange = (lastBeat - firstBeat); // may also be 0
-    const double newSeekPosition = ((newBeatRange == 0.0) ? 0.0 : ((seekBeat - firstBeat) / newBeatRange));
+    const double newSeekPosition = getNewPosition(this->getSeekPosition());
     
     //
     //          |----------- 0.7 ----|
@@ -549,6 +830,22 @@ void Transport::onChangeProjectBeatRange(float firstBeat, float lastBeat)
     //  2. calc (seekBeat - newFirstBeat) / (newLastBeat - newFirstBeat)
     //
     
+    const double oldTrackStartMs = this->trackStartMs;
+
+    if (this->trackStartMs != firstBeat * Transport::millisecondsPerBeat)
+    {
+        // all timestamps are relative to the track start
+        this->tempoMapIsOutdated = true;
+        this->sequencesAreOutdated = true;
+    }
+    
+    if (this->loopedMode)
+    {
+        // the loop stays at the same beats
+        this->loopStart = getNewPosition(this->loopStart);
+        this->loopEnd = getNewPosition(this->loopEnd);
+    }
+
     this->trackStartMs = firstBeat * Transport::millisecondsPerBeat;
     this->trackEndMs = lastBeat * Transport::millisecondsPerBeat;
     this->setTotalTime(this->trackEndMs - this->trackStartMs);
@@ -565,6 +862,14 @@ void Transport::onChangeProjectBeatRange(float firstBeat, float lastBeat)
     this->seekToPosition(newSeekPosition);
     this->projectFirstBeat = firstBeat;
     this->projectLastBeat = lastBeat;
+
+    if (this->isPlaying())
+    {
+        // re-exported with the new offsets and published like any other edit,
+        // and the player moves its position along with the timestamps
+        this->pendingTimeShift += (oldTrackStartMs - this->trackStartMs);
+        this->rebuildSequencesInRealtime();
+    }
 }
 
 
@@ -575,103 +880,162 @@ void Transport::onChangeProjectBeatRange(float firstBeat, float lastBeat)
 void Transport::calcTimeAndTempoAt(const double targetAbsPosition,
                                    double &outTimeMs, double &outTempo)
 {
-    this->rebuildSequencesIfNeeded();
-    this->sequences.seekToZeroIndexes();
+    this->rebuildTempoMapIfNeeded();
     
-    const double TPQN = Transport::millisecondsPerBeat; // ticks-per-quarter-note
     const double targetTime = round(targetAbsPosition * this->getTotalTime());
-    
-    outTimeMs = 0.0;
-    outTempo = 250.0 / TPQN; // default 240 BPM
-    
-    double prevTimestamp = 0.0;
-    double nextEventTimeDelta = 0.0;
-    bool foundFirstTempoEvent = false;
-    
-    MessageWrapper wrapper;
-    
-    while (this->sequences.getNextMessage(wrapper))
+    outTimeMs = this->tempoMap.getTimeMsAt(targetTime);
+    outTempo = this->tempoMap.getTempoAt(targetTime);
+}
+
+MidiMessage Transport::findFirstTempoEvent()
+{
+    this->rebuildTempoMapIfNeeded();
+    return this->tempoMap.getFirstTempoEvent();
+}
+
+
+//===----------------------------------------------------------------------===//
+// Sequences management
+//===----------------------------------------------------------------------===//
+
+void Transport::rebuildSequencesIfNeeded()
+{
+    if (this->sequencesAreOutdated)
     {
-        const double nextAbsPosition = (wrapper.message.getTimeStamp() / this->getTotalTime());
+        this->sequences.clear();
         
-        // foundFirstTempoEvent нужен для того, чтоб темп до первого события был равен темпу на первом событии
-        if (nextAbsPosition > targetAbsPosition &&
-            foundFirstTempoEvent)
+        ReferenceCountedArray<SequenceWrapper> wrappers;
+
+        for (int i = 0; i < this->tracksCache.size(); ++i)
         {
-            break;
+            this->createWrappersFor(this->tracksCache.getUnchecked(i)->getSequence(), wrappers);
+        }
+
+        for (auto wrapper : wrappers)
+        {
+            this->sequences.addWrapper(wrapper);
         }
         
-        nextEventTimeDelta = outTempo * (wrapper.message.getTimeStamp() - prevTimestamp);
-        outTimeMs += nextEventTimeDelta;
-        prevTimestamp = wrapper.message.getTimeStamp();
-        
-        if (wrapper.message.isTempoMetaEvent())
+        this->outdatedLayers.clearQuick();
+        this->sequencesAreOutdated = false;
+    }
+    else if (this->outdatedLayers.size() > 0)
+    {
+        // only re-export the edited tracks, the rest are shared
+        for (auto layer : this->outdatedLayers)
         {
-            outTempo = wrapper.message.getTempoSecondsPerQuarterNote() * 1000.f / TPQN;
-            foundFirstTempoEvent = true;
+            ReferenceCountedArray<SequenceWrapper> wrappers;
+            this->createWrappersFor(layer, wrappers);
+            this->sequences.updateWrappers(layer, wrappers);
         }
+        
+        this->outdatedLayers.clearQuick();
     }
-    
-    nextEventTimeDelta = outTempo * (targetTime - prevTimestamp);
-    outTimeMs += nextEventTimeDelta;
 }
 
-MidiMessage Transport::findFirstTempoEvent()
+void Transport::createWrappersFor(const MidiSequence *layer, ReferenceCountedArray<SequenceWrapper> &result)
 {
-    this->rebuildSequencesIfNeeded();
-    this->sequences.seekToZeroIndexes();
-    
-    MessageWrapper wrapper;
-    
-    while (this->sequences.getNextMessage(wrapper))
+    const MidiSequence::ExportedMidi::Ptr midi(layer->exportMidi());
+
+    if (midi->getNumEvents() == 0)
+    { return; }
+
+    // every clip is a view over the same exported events,
+    // so repeated clips don't take any memory for the events
+    Instrument *targetInstrument = this->linksCache[layer->getTrackId()];
+    const Array<float> clipOffsets(Pattern::getPlaybackOffsets(layer->getTrack()));
+
+    for (const float clipOffset : clipOffsets)
     {
-        if (wrapper.message.isTempoMetaEvent())
-        {
-            return wrapper.message;
-        }
+        auto wrapper = new SequenceWrapper();
+        wrapper->layer = layer;
+        wrapper->midi = midi;
+        wrapper->timeOffset = clipOffset * Transport::millisecondsPerBeat - this->trackStartMs;
+        wrapper->instrument = targetInstrument;
+        wrapper->listener = &targetInstrument->getProcessorPlayer().getMidiMessageCollector();
+        result.add(wrapper);
     }
+}
+
+void Transport::invalidateLayer(const MidiSequence *layer)
+{
+    this->outdatedLayers.addIfNotAlreadyThere(layer);
     
-    return MidiMessage::tempoMetaEvent(Transport::millisecondsPerBeat * 1000);
+    if (this->isPlaying())
+    {
+        // batch all the edits made within one message loop iteration
+        this->triggerAsyncUpdate();
+    }
 }
 
+void Transport::invalidateClips(const Pattern *pattern)
+{
+    const MidiTrack *track = pattern->getTrack();
 
-//===----------------------------------------------------------------------===//
-// Sequences management
-//===----------------------------------------------------------------------===//
+    // moving the tempo track's clips moves the tempo changes
+    if (track->isTempoTrack())
+    {
+        if (this->isPlaying())
+        { this->stopPlayback(); }
 
-void Transport::rebuildSequencesIfNeeded()
+        this->tempoMapIsOutdated = true;
+    }
+
+    this->invalidateLayer(track->getSequence());
+}
+
+PendingSequences *Transport::takePendingSequences()
 {
-    if (this->sequencesAreOutdated)
+    return this->pendingSequences.exchange(nullptr);
+}
+
+void Transport::discardPendingSequences()
+{
+    delete this->pendingSequences.exchange(nullptr);
+    this->pendingTimeShift = 0.0;
+}
+
+ProjectSequences Transport::getSequences()
+{
+    // todo add lock
+    return this->sequences;
+}
+
+void Transport::rebuildTempoMapIfNeeded()
+{
+    if (this->tempoMapIsOutdated)
     {
-        this->sequences.clear();
+        // only the tempo tracks are exported here, so that
+        // scrubbing does not need to re-merge the whole project
+        MidiMessageSequence tempoEvents;
         
         for (int i = 0; i < this->tracksCache.size(); ++i)
         {
-            const auto layer = this->tracksCache.getUnchecked(i)->getSequence();
-            MidiMessageSequence sequence(layer->exportMidi());
-            sequence.addTimeToMessages(-this->trackStartMs);
+            const MidiTrack *track = this->tracksCache.getUnchecked(i);
             
-            if (sequence.getNumEvents() > 0)
+            if (track->isTempoTrack())
             {
-                Instrument *targetInstrument = this->linksCache[layer->getTrackId()];
-                auto wrapper = new SequenceWrapper();
-                wrapper->layer = layer;
-                wrapper->sequence = sequence;
-                wrapper->currentIndex = 0;
-                wrapper->instrument = targetInstrument;
-                wrapper->listener = &targetInstrument->getProcessorPlayer().getMidiMessageCollector();
-                this->sequences.addWrapper(wrapper);
+                const MidiSequence::ExportedMidi::Ptr midi(track->getSequence()->exportMidi());
+
+                for (const float clipOffset : Pattern::getPlaybackOffsets(track))
+                {
+                    midi->addTo(tempoEvents, clipOffset * Transport::millisecondsPerBeat - this->trackStartMs);
+                }
             }
         }
         
-        this->sequencesAreOutdated = false;
+        tempoEvents.sort();
+        
+        const double TPQN = Transport::millisecondsPerBeat; // ticks-per-quarter-note
+        this->tempoMap = TempoMap(tempoEvents, TPQN, 250.0 / TPQN); // default 240 BPM
+        this->tempoMapIsOutdated = false;
     }
 }
 
-ProjectSequences Transport::getSequences()
+TempoMap Transport::getTempoMap()
 {
-    // todo add lock
-    return this->sequences;
+    this->rebuildTempoMapIfNeeded();
+    return this->tempoMap;
 }
 
 void Transport::updateLinkForTrack(const MidiTrack *track)
@@ -713,6 +1077,16 @@ void Transport::removeLinkForTrack(const MidiTrack *track)
 }
 
 
+//===----------------------------------------------------------------------===//
+// AsyncUpdater
+//===----------------------------------------------------------------------===//
+
+void Transport::handleAsyncUpdate()
+{
+    this->rebuildSequencesInRealtime();
+}
+
+
 //===----------------------------------------------------------------------===//
 // Transport Listeners
 //===----------------------------------------------------------------------===//
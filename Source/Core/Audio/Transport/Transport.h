@@ -18,20 +18,32 @@
 #pragma once
 
 class Instrument;
+class AudioCore;
 class OrchestraPit;
 class PlayerThread;
 class RendererThread;
+class PlaybackScheduler;
 
 #include "TransportListener.h"
 #include "ProjectSequencesWrapper.h"
+#include "TempoMap.h"
+#include "RenderFormat.h"
 #include "ProjectListener.h"
 #include "OrchestraListener.h"
 
-class Transport : public ProjectListener, private OrchestraListener
+class Transport : public ProjectListener,
+                  private OrchestraListener,
+                  private AsyncUpdater,
+                  private Timer
 {
 public:
 
+    explicit Transport(AudioCore &audioCore);
+
+    // Headless transport, not connected to any audio device,
+    // which is only able to render (see BatchRenderer)
     explicit Transport(OrchestraPit &orchestraPit);
+
     ~Transport() override;
 
     static const int millisecondsPerBeat = 500;
@@ -60,11 +72,17 @@ public:
     void stopPlayback();
     void toggleStatStopPlayback();
 
+    // The format defaults to the one set in config
     void startRender(const String &filename);
+    void startRender(const String &filename, const RenderFormat &format);
+    void startStemsRender(const String &filename, bool splitByTracks);
+    void startStemsRender(const String &filename, bool splitByTracks, const RenderFormat &format);
+    void setNumRenderWorkers(int numWorkers);
     bool isRendering() const;
     void stopRender();
     
     float getRenderingPercentsComplete() const;
+    RenderResults getRenderResults() const;
     
     void calcTimeAndTempoAt(const double absPosition,
                             double &outTimeMs,
@@ -100,6 +118,11 @@ public:
     void onRemoveMidiEvent(const MidiEvent &event) override;
     void onPostRemoveMidiEvent(MidiSequence *const layer) override;
 
+    void onAddClip(const Clip &clip) override;
+    void onChangeClip(const Clip &oldClip, const Clip &newClip) override;
+    void onRemoveClip(const Clip &clip) override;
+    void onPostRemoveClip(Pattern *const pattern) override;
+
     void onAddTrack(MidiTrack *const track) override;
     void onRemoveTrack(MidiTrack *const track) override;
     void onChangeTrackProperties(MidiTrack *const track) override;
@@ -131,20 +154,76 @@ protected:
 private:
     
     OrchestraPit &orchestra;
+    AudioCore *audioCore; // nullptr in a headless mode
 
     ScopedPointer<PlayerThread> player;
     ScopedPointer<RendererThread> renderer;
     
     friend class PlayerThread;
     friend class RendererThread;
+    friend class PlaybackScheduler;
+
+private:
+
+    // Block-based playback driven by the audio callback;
+    // the player thread is only used if it is disabled in config
+    ScopedPointer<PlaybackScheduler> scheduler;
+    bool blockBasedPlayback;
+    bool schedulerIsAttached;
+    double lastBroadcastTempo;
+
+    void attachScheduler();
+    void detachScheduler();
+    void interruptPlayback();
+
+    //===------------------------------------------------------------------===//
+    // Timer
+    //===------------------------------------------------------------------===//
+
+    void timerCallback() override;
 
 private:
 
     ProjectSequences getSequences();
     void rebuildSequencesIfNeeded();
+    void createWrappersFor(const MidiSequence *layer, ReferenceCountedArray<SequenceWrapper> &result);
     
     ProjectSequences sequences;
     bool sequencesAreOutdated;
+
+    // Layers to be re-exported without rebuilding everything else
+    Array<const MidiSequence *> outdatedLayers;
+    void invalidateLayer(const MidiSequence *layer);
+    void invalidateClips(const Pattern *pattern);
+
+    // A fresh copy of sequences, published for the player thread,
+    // which takes the ownership at its next event boundary
+    Atomic<PendingSequences *> pendingSequences;
+    PendingSequences *takePendingSequences();
+
+    // What the realtime scheduler has got (or is about to get),
+    // so that the changed listeners are found before publishing
+    ProjectSequences publishedSequences;
+    void discardPendingSequences();
+
+    // How much the timestamps have moved since the last published copy
+    double pendingTimeShift;
+
+    // The playback window in the current sequences' timestamps
+    void calcPlaybackRange(double &outStartTimeStamp, double &outEndTimeStamp) const;
+    double getPlayheadTimeStamp() const;
+
+    //===------------------------------------------------------------------===//
+    // AsyncUpdater
+    //===------------------------------------------------------------------===//
+
+    void handleAsyncUpdate() override;
+
+    TempoMap getTempoMap();
+    void rebuildTempoMapIfNeeded();
+
+    TempoMap tempoMap;
+    bool tempoMapIsOutdated;
     
     Array<const MidiTrack *> tracksCache;
     HashMap<String, Instrument *> linksCache; // layer id : instrument
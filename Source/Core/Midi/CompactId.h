@@ -0,0 +1,63 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// 64-bit ids for events and clips: a pair of them is compared and hashed
+// in one instruction, and they take no heap space, unlike uuid strings.
+// In a project file they are still saved as 16 hex digits, the same way
+// the old string ids were, so both old and new projects load the same ids.
+
+namespace CompactId
+{
+    using Type = int64;
+
+    // the lower half of a random uuid, as the string ids used to be
+    inline Type create() noexcept
+    {
+        const Uuid uuid;
+        return Type(ByteOrder::bigEndianInt64(uuid.getRawData() + 8));
+    }
+
+    inline String toString(Type id)
+    {
+        return String::toHexString(id).paddedLeft('0', 16);
+    }
+
+    inline Type fromString(const String &string)
+    {
+        if (string.isEmpty())
+        { return 0; }
+
+        // 32-digit clip ids keep their last 16 digits,
+        // anything else that is not hex just gets hashed
+        if (string.containsOnly("0123456789abcdefABCDEF"))
+        { return string.getLastCharacters(16).getHexValue64(); }
+
+        return string.hashCode64();
+    }
+
+    inline int compare(Type first, Type second) noexcept
+    {
+        return (first > second) - (first < second);
+    }
+
+    inline int hashCode(Type id) noexcept
+    {
+        return int(id ^ (id >> 32));
+    }
+}
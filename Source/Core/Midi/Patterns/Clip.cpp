@@ -50,7 +50,7 @@ float Clip::getStartBeat() const noexcept
     return this->startBeat;
 }
 
-String Clip::getId() const noexcept
+Clip::Id Clip::getId() const noexcept
 {
     return this->id;
 }
@@ -91,14 +91,17 @@ XmlElement *Clip::serialize() const
 {
     auto xml = new XmlElement(Serialization::Core::clip);
     xml->setAttribute("start", this->startBeat);
-    xml->setAttribute("id", this->id);
+    xml->setAttribute("id", CompactId::toString(this->id));
     return xml;
 }
 
 void Clip::deserialize(const XmlElement &xml)
 {
     this->startBeat = float(xml.getDoubleAttribute("start", this->startBeat));
-    this->id = xml.getStringAttribute("id", this->id);
+    if (xml.hasAttribute("id"))
+    {
+        this->id = CompactId::fromString(xml.getStringAttribute("id"));
+    }
 }
 
 void Clip::reset()
@@ -127,11 +130,10 @@ int Clip::compareElements(const Clip &first, const Clip &second)
 
 int Clip::hashCode() const noexcept
 {
-    return this->getId().hashCode();
+    return CompactId::hashCode(this->getId());
 }
 
 Clip::Id Clip::createId() noexcept
 {
-    Uuid uuid;
-    return uuid.toString();
+    return CompactId::create();
 }
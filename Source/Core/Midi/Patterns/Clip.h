@@ -18,6 +18,7 @@
 #pragma once
 
 #include "Serializable.h"
+#include "CompactId.h"
 
 class Pattern;
 
@@ -26,7 +27,7 @@ class Clip : public Serializable
 {
 public:
 
-    using Id = String;
+    using Id = CompactId::Type;
 
     Clip();
     Clip(const Clip &other);
@@ -34,7 +35,7 @@ public:
 
     Pattern *getPattern() const noexcept;
     float getStartBeat() const noexcept;
-    String getId() const noexcept;
+    Id getId() const noexcept;
 
     Clip copyWithNewId(Pattern *newOwner = nullptr) const;
     Clip withParameters(const XmlElement &xml) const;
@@ -69,7 +70,7 @@ private:
     Pattern *pattern;
 
     float startBeat;
-    String id;
+    Id id;
 
     static Id createId() noexcept;
 
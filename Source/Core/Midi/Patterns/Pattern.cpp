@@ -26,6 +26,8 @@
 
 Pattern::Pattern(MidiTrack &parentTrack,
     ProjectEventDispatcher &dispatcher) :
+    lastStartBeat(0.f),
+    lastEndBeat(0.f),
     track(parentTrack),
     eventDispatcher(dispatcher)
 {
@@ -112,6 +114,7 @@ bool Pattern::insert(Clip clip, const bool undoable)
     {
         this->clips.addSorted(clip, clip);
         this->notifyClipAdded(clip);
+        this->updateBeatRange(true);
     }
 
     return true;
@@ -132,6 +135,7 @@ bool Pattern::remove(Clip clip, const bool undoable)
         {
             this->clips.remove(index);
             this->notifyClipRemoved(clip);
+            this->updateBeatRange(true);
             return true;
         }
 
@@ -158,6 +162,7 @@ bool Pattern::change(Clip clip, Clip newClip, const bool undoable)
             this->clips.remove(index);
             this->clips.addSorted(newClip, newClip);
             this->notifyClipChanged(clip, newClip);
+            this->updateBeatRange(true);
             return true;
         }
 
@@ -217,6 +222,27 @@ void Pattern::notifyPatternChanged()
     this->eventDispatcher.dispatchChangeTrackContent(&this->track);
 }
 
+// The project's beat range depends on the first and the last clips
+void Pattern::updateBeatRange(bool shouldNotifyIfChanged)
+{
+    const float startBeat = (this->clips.size() > 0) ? this->clips.getFirst().getStartBeat() : 0.f;
+    const float endBeat = (this->clips.size() > 0) ? this->clips.getLast().getStartBeat() : 0.f;
+
+    if (this->lastStartBeat == startBeat &&
+        this->lastEndBeat == endBeat)
+    {
+        return;
+    }
+
+    this->lastStartBeat = startBeat;
+    this->lastEndBeat = endBeat;
+
+    if (shouldNotifyIfChanged)
+    {
+        this->eventDispatcher.dispatchChangeTrackBeatRange(&this->track);
+    }
+}
+
 
 //===----------------------------------------------------------------------===//
 // Serializable
@@ -262,6 +288,7 @@ void Pattern::deserialize(const XmlElement &xml)
     }
 
     this->sort();
+    this->updateBeatRange(false);
     this->notifyPatternChanged();
 }
 
@@ -286,6 +313,26 @@ String Pattern::getTrackId() const noexcept
     return this->track.getTrackId().toString();
 }
 
+Array<float> Pattern::getPlaybackOffsets(const MidiTrack *track)
+{
+    Array<float> result;
+
+    if (const Pattern *pattern = track->getPattern())
+    {
+        for (const auto &clip : pattern->clips)
+        {
+            result.add(clip.getStartBeat());
+        }
+    }
+
+    if (result.size() == 0)
+    {
+        result.add(0.f);
+    }
+
+    return result;
+}
+
 int Pattern::hashCode() const noexcept
 {
     return this->getTrackId().hashCode();
@@ -91,6 +91,7 @@ public:
     void notifyClipRemoved(const Clip &clip);
     void notifyClipRemovedPostAction();
     void notifyPatternChanged();
+    void updateBeatRange(bool shouldNotifyIfChanged);
 
     //===------------------------------------------------------------------===//
     // Serializable
@@ -107,6 +108,10 @@ public:
     MidiTrack *getTrack() const noexcept;
     String getTrackId() const noexcept;
 
+    // Beats at which the track's sequence is played, one per clip;
+    // a track with no pattern or no clips is played once at its own position
+    static Array<float> getPlaybackOffsets(const MidiTrack *track);
+
     friend inline bool operator==(const Pattern &lhs, const Pattern &rhs)
     {
         return (&lhs == &rhs);
@@ -118,6 +123,9 @@ protected:
 
     void clearQuick();
 
+    float lastStartBeat;
+    float lastEndBeat;
+
     ProjectTreeItem *getProject();
     UndoStack *getUndoStack();
 
@@ -156,12 +156,14 @@ bool AutomationSequence::change(const AutomationEvent &autoEvent, const Automati
     {
         if (AutomationEvent *matchingEvent = this->eventsHashTable[autoEvent])
         {
+            const int oldIndex = this->indexOfSorted(matchingEvent);
+
             (*matchingEvent) = newAutoEvent;
 
             this->eventsHashTable.removeValue(matchingEvent);
             this->eventsHashTable.set(newAutoEvent, matchingEvent);
             
-            this->sort();
+            this->relocateEvent(oldIndex);
             
             this->notifyEventChanged(autoEvent, *matchingEvent);
             this->updateBeatRange(true);
@@ -186,6 +188,9 @@ bool AutomationSequence::insertGroup(Array<AutomationEvent> &events, bool undoab
     }
     else
     {
+        Array<AutomationEvent *> storedEvents;
+        storedEvents.ensureStorageAllocated(events.size());
+
         for (int i = 0; i < events.size(); ++i)
         {
             const AutomationEvent &autoEvent = events.getUnchecked(i);
@@ -194,10 +199,18 @@ bool AutomationSequence::insertGroup(Array<AutomationEvent> &events, bool undoab
             
             this->midiEvents.add(storedEvent); // sorted later
             this->eventsHashTable.set(autoEvent, storedEvent);
-            this->notifyEventAdded(*storedEvent);
+            storedEvents.add(storedEvent);
         }
         
         this->sort();
+
+        // export ranges are looked up by the neighbours,
+        // so the notifications go only after sorting
+        for (auto storedEvent : storedEvents)
+        {
+            this->notifyEventAdded(*storedEvent);
+        }
+
         this->updateBeatRange(true);
     }
     
@@ -274,6 +287,36 @@ bool AutomationSequence::changeGroup(const Array<AutomationEvent> eventsBefore,
 }
 
 
+//===----------------------------------------------------------------------===//
+// Accessors
+//===----------------------------------------------------------------------===//
+
+int AutomationSequence::indexOfFirstEventAt(float beat) const
+{
+    MidiEvent *const *const first = this->midiEvents.begin();
+    MidiEvent *const *const last = this->midiEvents.end();
+
+    return int(std::lower_bound(first, last, beat,
+        [](const MidiEvent *event, float targetBeat)
+        {
+            return event->getBeat() < targetBeat;
+        }) - first);
+}
+
+void AutomationSequence::findEventsInRange(float startBeat, float endBeat, Array<AutomationEvent *> &result) const
+{
+    for (int i = this->indexOfFirstEventAt(startBeat); i < this->midiEvents.size(); ++i)
+    {
+        AutomationEvent *event = static_cast<AutomationEvent *>(this->midiEvents.getUnchecked(i));
+
+        if (event->getBeat() >= endBeat)
+        { break; }
+
+        result.add(event);
+    }
+}
+
+
 //===----------------------------------------------------------------------===//
 // Serializable
 //===----------------------------------------------------------------------===//
@@ -324,6 +367,42 @@ void AutomationSequence::deserialize(const XmlElement &xml)
     this->notifySequenceChanged();
 }
 
+void AutomationSequence::writeBinary(OutputStream &out) const
+{
+    out.writeCompressedInt(this->midiEvents.size());
+
+    for (int i = 0; i < this->midiEvents.size(); ++i)
+    {
+        const auto event = static_cast<const AutomationEvent *>(this->midiEvents.getUnchecked(i));
+        event->writeBinary(out);
+    }
+}
+
+void AutomationSequence::readBinary(InputStream &in)
+{
+    this->clearQuick();
+
+    const int numEvents = jmax(0, in.readCompressedInt());
+    this->midiEvents.ensureStorageAllocated(numEvents);
+
+    if (this->eventsHashTable.getNumSlots() < numEvents)
+    {
+        this->eventsHashTable.remapTable(numEvents);
+    }
+
+    for (int i = 0; i < numEvents && ! in.isExhausted(); ++i)
+    {
+        auto event = new AutomationEvent(this, 0, 0);
+        event->readBinary(in);
+        this->midiEvents.add(event);
+        this->eventsHashTable.set(*event, event);
+    }
+
+    this->sort();
+    this->updateBeatRange(false);
+    this->notifySequenceChanged();
+}
+
 void AutomationSequence::reset()
 {
     this->clearQuick();
@@ -335,3 +414,53 @@ void AutomationSequence::clearQuick()
     this->midiEvents.clearQuick(true);
     this->eventsHashTable.clear();
 }
+
+void AutomationSequence::exportEvents(Array<MidiMessage> &result) const
+{
+    this->exportEvents(0, FLT_MAX, result);
+}
+
+void AutomationSequence::exportEventsInRange(float startBeat, float endBeat, Array<MidiMessage> &result) const
+{
+    // the previous event is interpolated up to the range
+    this->exportEvents(jmax(0, this->indexOfFirstEventAt(startBeat) - 1), endBeat, result);
+}
+
+void AutomationSequence::exportEvents(int firstIndex, float endBeat, Array<MidiMessage> &result) const
+{
+    const int numEvents = this->midiEvents.size();
+
+    for (int i = firstIndex; i < numEvents; ++i)
+    {
+        const AutomationEvent *event = static_cast<AutomationEvent *>(this->midiEvents.getUnchecked(i));
+
+        if (event->getBeat() >= endBeat)
+        { break; }
+
+        const AutomationEvent *nextEvent = (i < numEvents - 1) ?
+            static_cast<AutomationEvent *>(this->midiEvents.getUnchecked(i + 1)) : nullptr;
+
+        event->exportMessages(nextEvent, result);
+    }
+}
+
+Range<float> AutomationSequence::getExportRange(const MidiEvent &event) const
+{
+    // the event is interpolated up to the next one,
+    // and the previous one is interpolated up to this one
+    const float beat = event.getBeat();
+    const int firstAtBeat = this->indexOfFirstEventAt(beat);
+
+    int firstAfterBeat = firstAtBeat;
+    while (firstAfterBeat < this->midiEvents.size() &&
+           this->midiEvents.getUnchecked(firstAfterBeat)->getBeat() <= beat)
+    { ++firstAfterBeat; }
+
+    const float startBeat = (firstAtBeat > 0) ?
+        this->midiEvents.getUnchecked(firstAtBeat - 1)->getBeat() : beat;
+
+    const float endBeat = (firstAfterBeat < this->midiEvents.size()) ?
+        this->midiEvents.getUnchecked(firstAfterBeat)->getBeat() : beat;
+
+    return Range<float>(startBeat, endBeat);
+}
@@ -57,6 +57,20 @@ public:
     void importMidi(const MidiMessageSequence &sequence) override;
 
 
+    //===------------------------------------------------------------------===//
+    // Accessors
+    //===------------------------------------------------------------------===//
+
+    // Automation events have no length, so the sorted events array
+    // is an index by itself, and both of these are binary searches
+
+    // The index of the first event at or after a given beat
+    int indexOfFirstEventAt(float beat) const;
+
+    // All events within [startBeat, endBeat)
+    void findEventsInRange(float startBeat, float endBeat, Array<AutomationEvent *> &result) const;
+
+
     //===------------------------------------------------------------------===//
     // Serializable
     //===------------------------------------------------------------------===//
@@ -70,9 +84,19 @@ public:
 protected:
 
     void clearQuick() override;
+    Range<float> getExportRange(const MidiEvent &event) const override;
+    void writeBinary(OutputStream &out) const override;
+    void readBinary(InputStream &in) override;
+
+    // Every event is interpolated up to the next one, which is known
+    // while iterating, so there's no need to look it up for each event
+    void exportEvents(Array<MidiMessage> &result) const override;
+    void exportEventsInRange(float startBeat, float endBeat, Array<MidiMessage> &result) const override;
 
 private:
 
+    void exportEvents(int firstIndex, float endBeat, Array<MidiMessage> &result) const;
+
     // быстрый доступ к указателю на событие по соответствующим ему параметрам
     HashMap<AutomationEvent, AutomationEvent *, AutomationEventHashFunction> eventsHashTable;
 
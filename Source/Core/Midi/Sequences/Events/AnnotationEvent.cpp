@@ -126,7 +126,7 @@ XmlElement *AnnotationEvent::serialize() const
     xml->setAttribute("text", this->description);
     xml->setAttribute("col", this->colour.toString());
     xml->setAttribute("beat", this->beat);
-    xml->setAttribute("id", this->id);
+    xml->setAttribute("id", CompactId::toString(this->id));
     return xml;
 }
 
@@ -138,7 +138,7 @@ void AnnotationEvent::deserialize(const XmlElement &xml)
     this->description = xml.getStringAttribute("text");
     this->colour = Colour::fromString(xml.getStringAttribute("col"));
     this->beat = float(xml.getDoubleAttribute("beat"));
-    this->id = xml.getStringAttribute("id");
+    this->id = CompactId::fromString(xml.getStringAttribute("id"));
 }
 
 void AnnotationEvent::reset()
@@ -146,11 +146,27 @@ void AnnotationEvent::reset()
     // здесь ничего пока не чистим, это не нужно и вообще, проверь скорость работы сериализации.
 }
 
+void AnnotationEvent::writeBinary(OutputStream &out) const
+{
+    out.writeInt64(this->id);
+    out.writeFloat(this->beat);
+    out.writeInt(int(this->colour.getARGB()));
+    out.writeString(this->description);
+}
+
+void AnnotationEvent::readBinary(InputStream &in)
+{
+    this->id = in.readInt64();
+    this->beat = in.readFloat();
+    this->colour = Colour(uint32(in.readInt()));
+    this->description = in.readString();
+}
+
 
 int AnnotationEvent::hashCode() const noexcept
 {
     return this->getDescription().hashCode() +
-           this->getId().hashCode();
+           CompactId::hashCode(this->getId());
 }
 
 AnnotationEvent &AnnotationEvent::operator=(const AnnotationEvent &right)
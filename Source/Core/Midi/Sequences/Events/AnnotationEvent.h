@@ -70,6 +70,9 @@ public:
 
     void reset() override;
 
+    void writeBinary(OutputStream &out) const override;
+    void readBinary(InputStream &in) override;
+
 
     //===------------------------------------------------------------------===//
     // Stuff for hashtables
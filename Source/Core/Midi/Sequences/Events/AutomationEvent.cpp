@@ -67,107 +67,121 @@ float easeOutExpo(float delta, float factor)
     return delta * (-powf(2.f, -16.f * factor) + 1.f);
 };
 
+// The curve's shape only depends on the interpolation factor and easing,
+// so both of its exponential parts are tabulated once:
 // easing == 0: ease out
 // easing == 1: ease in
-float exponentalInterpolation(float y0, float y1, float factor, float easing)
+#define CURVE_TABLE_SIZE 1024
+
+struct CurveTable
 {
-    const float delta = y1 - y0;
-    
-//    const float e = (easing * 2.f) - 1.f;
-//===----------------------------------------------------------------------===//
-//    if (e > 0)
-//    {
-//        const float easeIn = easeInExpo(delta, factor) * e;
-//        const float linear = linearTween(delta, factor) * (1.f - e);
-//        return y0 + (easeIn + linear);
-//    }
-//    
-//    const float easeOut = easeOutExpo(delta, factor) * -e;
-//    const float linear = linearTween(delta, factor) * (1.f + e);
-//    return y0 + (easeOut + linear);
-    
-    const float easeIn = easeInExpo(delta, factor) * easing;
-    const float easeOut = easeOutExpo(delta, factor) * (1.f - easing);
-    return y0 + (easeIn + easeOut);
+    CurveTable()
+    {
+        for (int i = 0; i <= CURVE_TABLE_SIZE; ++i)
+        {
+            const float factor = float(i) / CURVE_TABLE_SIZE;
+            this->easeIn[i] = easeInExpo(1.f, factor);
+            this->easeOut[i] = easeOutExpo(1.f, factor);
+        }
+    }
+
+    inline float getShape(float factor, float easing) const noexcept
+    {
+        const float position = jlimit(0.f, 1.f, factor) * CURVE_TABLE_SIZE;
+        const int index = jmin(int(position), CURVE_TABLE_SIZE - 1);
+        const float fraction = position - index;
+
+        const float in = this->easeIn[index] + (this->easeIn[index + 1] - this->easeIn[index]) * fraction;
+        const float out = this->easeOut[index] + (this->easeOut[index + 1] - this->easeOut[index]) * fraction;
+        return in * easing + out * (1.f - easing);
+    }
+
+    float easeIn[CURVE_TABLE_SIZE + 1];
+    float easeOut[CURVE_TABLE_SIZE + 1];
+};
+
+static const CurveTable &getCurveTable()
+{
+    static CurveTable table;
+    return table;
+}
+
+// The value as it is sent, so that the steps which don't change it could be skipped
+static inline int getMessageValue(float controllerValue, bool isTempoTrack)
+{
+    return isTempoTrack ?
+        int((1.f - controllerValue) * Transport::millisecondsPerBeat * 1000) :
+        int(controllerValue * 127);
 }
 
+static inline MidiMessage createMessage(int messageValue, bool isTempoTrack,
+    int channel, int controllerNumber, float timeStamp)
+{
+    MidiMessage message(isTempoTrack ?
+        MidiMessage::tempoMetaEvent(messageValue) :
+        MidiMessage::controllerEvent(channel, controllerNumber, messageValue));
+
+    message.setTimeStamp(timeStamp);
+    return message;
+}
 
 Array<MidiMessage> AutomationEvent::toMidiMessages() const
 {
     Array<MidiMessage> result;
-    
-    // теперь пусть все треки автоматизации ведут себя одинаково
-    //if (this->getSequence()->isTempoLayer())
+
+    const int indexOfThis = this->getSequence()->indexOfSorted(this);
+    const AutomationEvent *nextEvent = nullptr;
+
+    if (indexOfThis >= 0 && indexOfThis < (this->getSequence()->size() - 1))
     {
-        MidiMessage cc;
-        const bool isTempoTrack = this->getSequence()->getTrack()->isTempoTrack();
+        nextEvent = static_cast<AutomationEvent *>(this->getSequence()->getUnchecked(indexOfThis + 1));
+    }
 
-        if (isTempoTrack)
-        {
-            cc = MidiMessage::tempoMetaEvent(int((1.f - this->controllerValue) * Transport::millisecondsPerBeat * 1000));
-        }
-        else
-        {
-            cc = MidiMessage::controllerEvent(this->getChannel(),
-                                              this->getControllerNumber(),
-                                              int(this->controllerValue * 127));
-        
-        }
+    this->exportMessages(nextEvent, result);
+    return result;
+}
+
+void AutomationEvent::exportMessages(const AutomationEvent *nextEvent, Array<MidiMessage> &result) const
+{
+    // теперь пусть все треки автоматизации ведут себя одинаково
+    const bool isTempoTrack = this->getSequence()->getTrack()->isTempoTrack();
+    const int channel = this->getChannel();
+    const int controllerNumber = this->getControllerNumber();
+
+    const float startTime = this->beat * Transport::millisecondsPerBeat;
+    int lastValue = getMessageValue(this->controllerValue, isTempoTrack);
+    result.add(createMessage(lastValue, isTempoTrack, channel, controllerNumber, startTime));
+
+    // добавить интерполированные события, если таковые должны быть
+    if (nextEvent == nullptr)
+    { return; }
+
+    const float controllerDelta = nextEvent->controllerValue - this->controllerValue;
 
-        const float &startTime = this->beat * Transport::millisecondsPerBeat;
-        cc.setTimeStamp(startTime);
-        result.add(cc);
+    if (fabs(controllerDelta) <= MIN_INTERPOLATED_CONTROLLER_DELTA)
+    { return; }
 
-        
-        // добавить интерполированные события, если таковые должны быть
-        const int indexOfThis = this->getSequence()->indexOfSorted(this);
-        
-        if (indexOfThis >= 0 && indexOfThis < (this->getSequence()->size() - 1))
+    const float nextTime = nextEvent->beat * Transport::millisecondsPerBeat;
+    const float duration = nextTime - startTime;
+    const float easing = (this->controllerValue > nextEvent->controllerValue) ? this->curvature : (1.f - this->curvature);
+    const CurveTable &curve = getCurveTable();
+
+    for (float timeStamp = startTime + INTERPOLATED_EVENTS_STEP_MS;
+         timeStamp < nextTime;
+         timeStamp += INTERPOLATED_EVENTS_STEP_MS)
+    {
+        const float interpolatedControllerValue =
+            this->controllerValue + controllerDelta * curve.getShape((timeStamp - startTime) / duration, easing);
+
+        const int value = getMessageValue(interpolatedControllerValue, isTempoTrack);
+
+        // flat parts of the curve send nothing
+        if (value != lastValue)
         {
-            const AutomationEvent *nextEvent = static_cast<AutomationEvent *>(this->getSequence()->getUnchecked(indexOfThis + 1));
-            const float controllerDelta = fabs(this->controllerValue - nextEvent->controllerValue);
-            
-            if (controllerDelta > MIN_INTERPOLATED_CONTROLLER_DELTA)
-            {
-                const float nextTime = nextEvent->beat * Transport::millisecondsPerBeat;
-                float interpolatedEventTimeStamp = startTime + INTERPOLATED_EVENTS_STEP_MS;
-                
-                while (interpolatedEventTimeStamp < nextTime)
-                {
-                    const float lerpFactor = (interpolatedEventTimeStamp - startTime) / (nextTime - startTime);
-                    const float c = (this->controllerValue > nextEvent->controllerValue) ? this->curvature : (1.f - this->curvature);
-                    
-                    const float interpolatedControllerValue = exponentalInterpolation(this->controllerValue,
-                                                                                      nextEvent->controllerValue,
-                                                                                      lerpFactor,
-                                                                                      c);
-                    
-                    //Logger::writeToLog(String(this->curvature) + " :: " + String((interpolatedControllerValue - this->controllerValue) / (nextEvent->controllerValue - this->controllerValue) - lerpFactor));
-                    
-                    //Logger::writeToLog(String(this->controllerValue) + " - " + String(interpolatedControllerValue) + " - " + String(nextEvent->controllerValue));
-                    
-                    if (isTempoTrack)
-                    {
-                        MidiMessage ci(MidiMessage::tempoMetaEvent(int((1.f - interpolatedControllerValue) * Transport::millisecondsPerBeat * 1000)));
-                        ci.setTimeStamp(interpolatedEventTimeStamp);
-                        result.add(ci);
-                    }
-                    else
-                    {
-                        MidiMessage ci(MidiMessage::controllerEvent(this->getChannel(),
-                                                                    this->getControllerNumber(),
-                                                                    int(this->controllerValue * 127)));
-                        ci.setTimeStamp(interpolatedEventTimeStamp);
-                        result.add(ci);
-                    }
-                    
-                    interpolatedEventTimeStamp += INTERPOLATED_EVENTS_STEP_MS;
-                }
-            }
+            result.add(createMessage(value, isTempoTrack, channel, controllerNumber, timeStamp));
+            lastValue = value;
         }
     }
-
-    return result;
 }
 
 AutomationEvent AutomationEvent::copyWithNewId() const
@@ -281,8 +295,7 @@ XmlElement *AutomationEvent::serialize() const
     xml->setAttribute("val", this->controllerValue);
     xml->setAttribute("beat", this->beat);
     xml->setAttribute("curve", this->curvature);
-    //xml->setAttribute("id", this->id.toString());
-    xml->setAttribute("id", this->id);
+    xml->setAttribute("id", CompactId::toString(this->id));
     return xml;
 }
 
@@ -294,7 +307,7 @@ void AutomationEvent::deserialize(const XmlElement &xml)
     this->controllerValue = float(xml.getDoubleAttribute("val"));
     this->curvature = float(xml.getDoubleAttribute("curve", AUTOEVENT_DEFAULT_CURVATURE));
     this->beat = float(xml.getDoubleAttribute("beat"));
-    this->id = xml.getStringAttribute("id");
+    this->id = CompactId::fromString(xml.getStringAttribute("id"));
 }
 
 void AutomationEvent::reset()
@@ -302,12 +315,28 @@ void AutomationEvent::reset()
     // здесь ничего пока не чистим, это не нужно и вообще, проверь скорость работы сериализации.
 }
 
+void AutomationEvent::writeBinary(OutputStream &out) const
+{
+    out.writeInt64(this->id);
+    out.writeFloat(this->beat);
+    out.writeFloat(this->controllerValue);
+    out.writeFloat(this->curvature);
+}
+
+void AutomationEvent::readBinary(InputStream &in)
+{
+    this->id = in.readInt64();
+    this->beat = in.readFloat();
+    this->controllerValue = in.readFloat();
+    this->curvature = in.readFloat();
+}
+
 
 int AutomationEvent::hashCode() const noexcept
 {
     return roundFloatToInt(this->getControllerValue() * 1000) +
            roundFloatToInt(this->getBeat() * 1000) +
-           this->getId().hashCode();
+           CompactId::hashCode(this->getId());
 }
 
 AutomationEvent &AutomationEvent::operator=(const AutomationEvent &right)
@@ -37,6 +37,10 @@ public:
 
     Array<MidiMessage> toMidiMessages() const override;
 
+    // Appends the event's message, and the interpolated ones up to the next event;
+    // this is for sequences, which iterate the events in order anyway
+    void exportMessages(const AutomationEvent *nextEvent, Array<MidiMessage> &result) const;
+
     
     AutomationEvent copyWithNewId() const;
 
@@ -85,6 +89,9 @@ public:
 
     void reset() override;
 
+    void writeBinary(OutputStream &out) const override;
+    void readBinary(InputStream &in) override;
+
 
     //===------------------------------------------------------------------===//
     // Stuff for hashtables
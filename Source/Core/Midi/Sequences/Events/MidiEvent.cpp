@@ -68,12 +68,8 @@ float MidiEvent::getBeat() const noexcept
     return this->beat;
 }
 
-//static MidiEvent::Id recentId = 0;
-
 MidiEvent::Id MidiEvent::createId() noexcept
 {
-    Uuid uuid;
-    return uuid.toString().substring(16, 32);
-//    return ++recentId;
+    return CompactId::create();
 }
 
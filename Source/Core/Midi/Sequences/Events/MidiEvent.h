@@ -18,6 +18,7 @@
 #pragma once
 
 #include "Serializable.h"
+#include "CompactId.h"
 
 class MidiSequence;
 
@@ -25,14 +26,12 @@ class MidiEvent : public Serializable
 {
 public:
 
-    using Id = String;
-
     // 128 бит нам ни к чему, пусть будет 64,
     // с моими раскладами остается вероятность коллизии где-то 10^-8 .. 10^-11
     // при самых пессимистичных прогнозах,
     // а так, если на одном слое будет ~4000 нот, эта вероятность будет 4 * 10^-13
 
-    //using Id = int64;
+    using Id = CompactId::Type;
 
     MidiEvent(MidiSequence *owner, float beat);
 
@@ -40,6 +39,10 @@ public:
 
     virtual Array<MidiMessage> toMidiMessages() const = 0;
 
+    // The compact form for the chunked project file and the VCS event deltas
+    virtual void writeBinary(OutputStream &out) const = 0;
+    virtual void readBinary(InputStream &in) = 0;
+
 
     //===------------------------------------------------------------------===//
     // Accessors
@@ -67,7 +70,7 @@ public:
         const int diffResult = (diff > 0.f) - (diff < 0.f);
         if (diffResult != 0) { return diffResult; }
         
-        return first->getId().compare(second->getId());
+        return CompactId::compare(first->getId(), second->getId());
     }
 
 protected:
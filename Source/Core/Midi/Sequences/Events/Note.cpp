@@ -192,7 +192,7 @@ XmlElement *Note::serialize() const
     xml->setAttribute("beat", this->beat);
     xml->setAttribute("len", this->length);
     xml->setAttribute("vel", roundFloatToInt(this->velocity * VELOCITY_SAVE_ACCURACY));
-    xml->setAttribute("id", this->id);
+    xml->setAttribute("id", CompactId::toString(this->id));
     return xml;
 }
 
@@ -207,7 +207,7 @@ void Note::deserialize(const XmlElement &xml)
     const float xmlBeat = float(xml.getDoubleAttribute("beat"));
     const float xmlLength = float(xml.getDoubleAttribute("len"));
     const float xmlVelocity = float(xml.getIntAttribute("vel")) / VELOCITY_SAVE_ACCURACY;
-    const String& xmlId = xml.getStringAttribute("id");
+    const Id xmlId = CompactId::fromString(xml.getStringAttribute("id"));
 
     this->key = xmlKey;
     this->beat = xmlBeat;
@@ -220,6 +220,24 @@ void Note::reset()
 {
 }
 
+void Note::writeBinary(OutputStream &out) const
+{
+    out.writeInt64(this->id);
+    out.writeFloat(this->beat);
+    out.writeFloat(this->length);
+    out.writeFloat(this->velocity);
+    out.writeCompressedInt(this->key);
+}
+
+void Note::readBinary(InputStream &in)
+{
+    this->id = in.readInt64();
+    this->beat = in.readFloat();
+    this->length = in.readFloat();
+    this->velocity = jmax(jmin(in.readFloat(), 1.f), 0.f);
+    this->key = in.readCompressedInt();
+}
+
 
 Note &Note::operator=(const Note &right)
 {
@@ -235,5 +253,5 @@ Note &Note::operator=(const Note &right)
 
 int Note::hashCode() const noexcept
 {
-    return this->getId().hashCode();
+    return CompactId::hashCode(this->getId());
 }
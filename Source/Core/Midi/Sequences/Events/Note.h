@@ -81,6 +81,9 @@ public:
 
     void reset() override;
 
+    void writeBinary(OutputStream &out) const override;
+    void readBinary(InputStream &in) override;
+
 
     //===------------------------------------------------------------------===//
     // Stuff for hashtables
@@ -104,7 +107,7 @@ public:
         const int diffResult = (diff > 0.f) - (diff < 0.f);
         if (diffResult != 0) { return diffResult; }
         
-        return first->getId().compare(second->getId());
+        return CompactId::compare(first->getId(), second->getId());
     }
     
     static int compareElements(Note *const first, Note *const second)
@@ -119,7 +122,7 @@ public:
         const int keyResult = (keyDiff > 0) - (keyDiff < 0);
         if (keyResult != 0) { return keyResult; }
         
-        return first->getId().compare(second->getId());
+        return CompactId::compare(first->getId(), second->getId());
     }
     
     static int compareElements(const Note &first, const Note &second)
@@ -133,7 +136,7 @@ public:
         const int keyResult = (keyDiff > 0) - (keyDiff < 0);
         if (keyResult != 0) { return keyResult; }
         
-        return first.getId().compare(second.getId());
+        return CompactId::compare(first.getId(), second.getId());
     }
 
 protected:
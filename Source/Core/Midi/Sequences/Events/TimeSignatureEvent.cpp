@@ -152,7 +152,7 @@ XmlElement *TimeSignatureEvent::serialize() const
     xml->setAttribute("numerator", this->numerator);
     xml->setAttribute("denominator", this->denominator);
     xml->setAttribute("beat", this->beat);
-    xml->setAttribute("id", this->id);
+    xml->setAttribute("id", CompactId::toString(this->id));
     return xml;
 }
 
@@ -162,17 +162,33 @@ void TimeSignatureEvent::deserialize(const XmlElement &xml)
     this->numerator = xml.getIntAttribute("numerator", TIME_SIGNATURE_DEFAULT_NUMERATOR);
     this->denominator = xml.getIntAttribute("denominator", TIME_SIGNATURE_DEFAULT_DENOMINATOR);
     this->beat = float(xml.getDoubleAttribute("beat"));
-    this->id = xml.getStringAttribute("id");
+    this->id = CompactId::fromString(xml.getStringAttribute("id"));
 }
 
 void TimeSignatureEvent::reset()
 {
 }
 
+void TimeSignatureEvent::writeBinary(OutputStream &out) const
+{
+    out.writeInt64(this->id);
+    out.writeFloat(this->beat);
+    out.writeCompressedInt(this->numerator);
+    out.writeCompressedInt(this->denominator);
+}
+
+void TimeSignatureEvent::readBinary(InputStream &in)
+{
+    this->id = in.readInt64();
+    this->beat = in.readFloat();
+    this->numerator = in.readCompressedInt();
+    this->denominator = in.readCompressedInt();
+}
+
 
 int TimeSignatureEvent::hashCode() const noexcept
 {
-    return this->numerator + (100 * this->denominator) + this->id.hashCode();
+    return this->numerator + (100 * this->denominator) + CompactId::hashCode(this->id);
 }
 
 TimeSignatureEvent &TimeSignatureEvent::operator=(const TimeSignatureEvent &right)
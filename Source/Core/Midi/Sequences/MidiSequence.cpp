@@ -21,6 +21,13 @@
 #include "ProjectTreeItem.h"
 #include "UndoStack.h"
 #include "MidiTrack.h"
+#include "Transport.h"
+
+#define EXPORT_BUCKET_BEATS 16
+
+// Timestamps are calculated in floats, so the bucket of a message
+// right at the border might be the neighbour of its beat's bucket
+#define EXPORT_BUCKET_MARGIN_BEATS 0.125f
 
 MidiSequence::MidiSequence(MidiTrack &parentTrack,
     ProjectEventDispatcher &dispatcher) :
@@ -28,8 +35,11 @@ MidiSequence::MidiSequence(MidiTrack &parentTrack,
     eventDispatcher(dispatcher),
     lastStartBeat(0.f),
     lastEndBeat(0.f),
+    firstBucketIndex(0),
+    hasOutdatedBuckets(false),
     cachedSequence(),
-    cacheIsOutdated(false)
+    cacheIsOutdated(true),
+    binaryChunkIsOutdated(true)
 {
 }
 
@@ -46,6 +56,88 @@ void MidiSequence::sort()
     }
 }
 
+static bool isEventLess(const MidiEvent *first, const MidiEvent *second)
+{
+    return MidiEvent::compareElements(first, second) < 0;
+}
+
+int MidiSequence::relocateEvent(int index)
+{
+    const int numEvents = this->midiEvents.size();
+    MidiEvent **events = this->midiEvents.getRawDataPointer();
+    MidiEvent *const event = events[index];
+
+    int newIndex = index;
+
+    if (index > 0 && isEventLess(event, events[index - 1]))
+    {
+        newIndex = int(std::upper_bound(events, events + index, event, isEventLess) - events);
+    }
+    else if (index < numEvents - 1 && isEventLess(events[index + 1], event))
+    {
+        newIndex = int(std::lower_bound(events + index + 1, events + numEvents, event, isEventLess) - events) - 1;
+    }
+
+    if (newIndex != index)
+    {
+        this->midiEvents.move(index, newIndex);
+    }
+
+    return newIndex;
+}
+
+void MidiSequence::mergeChangedEvents(Array<int> &changedIndices)
+{
+    if (changedIndices.size() == 0)
+    { return; }
+
+    changedIndices.sort();
+
+    const int numEvents = this->midiEvents.size();
+    MidiEvent **events = this->midiEvents.getRawDataPointer();
+
+    Array<MidiEvent *> changedEvents;
+    changedEvents.ensureStorageAllocated(changedIndices.size());
+
+    // take the changed ones out, keeping the rest in order
+    int numKept = 0;
+    int nextChanged = 0;
+
+    for (int i = 0; i < numEvents; ++i)
+    {
+        if (nextChanged < changedIndices.size() && changedIndices.getUnchecked(nextChanged) == i)
+        {
+            changedEvents.add(events[i]);
+
+            while (nextChanged < changedIndices.size() && changedIndices.getUnchecked(nextChanged) == i)
+            { ++nextChanged; }
+        }
+        else
+        {
+            events[numKept++] = events[i];
+        }
+    }
+
+    std::sort(changedEvents.begin(), changedEvents.end(), isEventLess);
+
+    // merge from the back, so that nothing is overwritten before it is moved
+    int kept = numKept - 1;
+    int changed = changedEvents.size() - 1;
+    int target = numEvents - 1;
+
+    while (changed >= 0)
+    {
+        if (kept >= 0 && isEventLess(changedEvents.getUnchecked(changed), events[kept]))
+        {
+            events[target--] = events[kept--];
+        }
+        else
+        {
+            events[target--] = changedEvents.getUnchecked(changed--);
+        }
+    }
+}
+
 //===----------------------------------------------------------------------===//
 // Undoing // TODO move this to project interface
 //
@@ -82,36 +174,360 @@ void MidiSequence::clearUndoHistory()
 // Import/export
 //
 
-MidiMessageSequence MidiSequence::exportMidi() const
+static bool isMessageEarlier(const MidiMessage &first, const MidiMessage &second)
+{
+    return first.getTimeStamp() < second.getTimeStamp();
+}
+
+static inline int getBucketIndex(double beat)
+{
+    return int(std::floor(beat / EXPORT_BUCKET_BEATS));
+}
+
+static inline int getBucketIndex(const MidiMessage &message)
+{
+    return getBucketIndex(message.getTimeStamp() / Transport::millisecondsPerBeat);
+}
+
+int MidiSequence::ExportedMidi::getNumEvents() const noexcept
+{
+    return this->numEvents;
+}
+
+const MidiMessage &MidiSequence::ExportedMidi::getMessage(int index) const noexcept
+{
+    jassert(index >= 0 && index < this->numEvents);
+
+    // the last chunk which starts at or before the index
+    const int *const first = this->chunkStarts.begin();
+    const int chunkIndex = int(std::upper_bound(first, this->chunkStarts.end(), index) - first) - 1;
+    const Chunk *chunk = this->chunks.getUnchecked(chunkIndex);
+    return chunk->messages.getReference(index - this->chunkStarts.getUnchecked(chunkIndex));
+}
+
+double MidiSequence::ExportedMidi::getTimeStamp(int index) const noexcept
+{
+    return this->getMessage(index).getTimeStamp();
+}
+
+int MidiSequence::ExportedMidi::findIndex(double timeStamp, bool skipEqual) const noexcept
+{
+    auto isBefore = [timeStamp, skipEqual](double t)
+    {
+        return t < timeStamp || (skipEqual && t == timeStamp);
+    };
+
+    // the first chunk which has such messages is the first one which ends with one
+    Chunk *const *const firstChunk = this->chunks.begin();
+    Chunk *const *const chunk = std::partition_point(firstChunk, this->chunks.end(),
+        [&isBefore](const Chunk *c) { return isBefore(c->timeStamps.getLast()); });
+
+    if (chunk == this->chunks.end())
+    { return this->numEvents; }
+
+    const double *const first = (*chunk)->timeStamps.begin();
+    const int indexInChunk = int(std::partition_point(first, (*chunk)->timeStamps.end(), isBefore) - first);
+    return this->chunkStarts.getUnchecked(int(chunk - firstChunk)) + indexInChunk;
+}
+
+void MidiSequence::ExportedMidi::addTo(MidiMessageSequence &target, double timeAdjustment) const
+{
+    for (auto chunk : this->chunks)
+    {
+        for (const auto &message : chunk->messages)
+        {
+            target.addEvent(message, timeAdjustment);
+        }
+    }
+}
+
+MidiSequence::ExportedMidi::Ptr MidiSequence::exportMidi() const
 {
     if (this->track.isTrackMuted())
     {
-        return MidiMessageSequence();
+        return new ExportedMidi();
     }
-    
+
+    if (this->cachedSequence != nullptr &&
+        ! this->cacheIsOutdated &&
+        ! this->hasOutdatedBuckets)
+    {
+        return this->cachedSequence;
+    }
+
     if (this->cacheIsOutdated)
     {
-        this->cachedSequence.clear();
+        this->exportAllBuckets();
+    }
+    else
+    {
+        this->exportOutdatedBuckets();
+        jassert(this->isExportConsistent());
+    }
+
+    // only the outdated buckets have got new chunks,
+    // all the others are shared with the previous export
+    ExportedMidi::Ptr exported(new ExportedMidi());
+    exported->chunks.ensureStorageAllocated(this->exportBuckets.size());
+    exported->chunkStarts.ensureStorageAllocated(this->exportBuckets.size());
+
+    for (auto bucket : this->exportBuckets)
+    {
+        if (bucket->chunk != nullptr && bucket->chunk->messages.size() > 0)
+        {
+            exported->chunkStarts.add(exported->numEvents);
+            exported->chunks.add(bucket->chunk);
+            exported->numEvents += bucket->chunk->messages.size();
+        }
+    }
+
+    // the previous one may still be used by somebody,
+    // so it's replaced instead of being rebuilt in place
+    this->cachedSequence = exported;
+    this->cacheIsOutdated = false;
+    this->hasOutdatedBuckets = false;
+
+    return this->cachedSequence;
+}
+
+static void addToChunk(MidiSequence::ExportedMidi::Chunk &chunk, const MidiMessage &message)
+{
+    chunk.messages.add(message);
+    chunk.timeStamps.add(message.getTimeStamp());
+}
+
+void MidiSequence::exportAllBuckets() const
+{
+    this->exportBuffer.clearQuick();
+    this->exportEvents(this->exportBuffer);
+
+    // the stable sort keeps the messages with equal timestamps in the
+    // same order as one sorted insertion per message used to
+    std::stable_sort(this->exportBuffer.begin(), this->exportBuffer.end(), isMessageEarlier);
+
+    this->exportBuckets.clearQuick(true);
+
+    if (this->exportBuffer.size() == 0)
+    { return; }
+
+    this->firstBucketIndex = getBucketIndex(this->exportBuffer.getReference(0));
+    const int lastBucketIndex = getBucketIndex(this->exportBuffer.getLast());
+
+    for (int i = this->firstBucketIndex; i <= lastBucketIndex; ++i)
+    {
+        ExportBucket *bucket = this->exportBuckets.add(new ExportBucket());
+        bucket->chunk = new ExportedMidi::Chunk();
+        bucket->isOutdated = false;
+    }
+
+    for (const auto &message : this->exportBuffer)
+    {
+        const int bucketIndex = getBucketIndex(message) - this->firstBucketIndex;
+        addToChunk(*this->exportBuckets.getUnchecked(bucketIndex)->chunk, message);
+    }
+}
+
+void MidiSequence::exportOutdatedBuckets() const
+{
+    const int numBuckets = this->exportBuckets.size();
+    int i = 0;
+
+    while (i < numBuckets)
+    {
+        if (! this->exportBuckets.getUnchecked(i)->isOutdated)
+        {
+            ++i;
+            continue;
+        }
+
+        // neighbouring outdated buckets are exported at once
+        int last = i;
+        while (last + 1 < numBuckets && this->exportBuckets.getUnchecked(last + 1)->isOutdated)
+        { ++last; }
+
+        const int firstIndex = this->firstBucketIndex + i;
+        const int lastIndex = this->firstBucketIndex + last;
+
+        this->exportBuffer.clearQuick();
+        this->exportEventsInRange(float(firstIndex * EXPORT_BUCKET_BEATS) - EXPORT_BUCKET_MARGIN_BEATS,
+                                  float((lastIndex + 1) * EXPORT_BUCKET_BEATS) + EXPORT_BUCKET_MARGIN_BEATS,
+                                  this->exportBuffer);
 
-        for (auto event : this->midiEvents)
+        std::stable_sort(this->exportBuffer.begin(), this->exportBuffer.end(), isMessageEarlier);
+
+        // the old chunks may be shared with the previous export,
+        // so they are replaced, not cleared
+        for (int j = i; j <= last; ++j)
         {
-            const auto &track = event->toMidiMessages();
+            ExportBucket *bucket = this->exportBuckets.getUnchecked(j);
+            bucket->chunk = new ExportedMidi::Chunk();
+            bucket->isOutdated = false;
+        }
 
-            for (auto &message : track)
+        for (const auto &message : this->exportBuffer)
+        {
+            const int bucketIndex = getBucketIndex(message);
+
+            if (bucketIndex >= firstIndex && bucketIndex <= lastIndex)
             {
-                this->cachedSequence.addEvent(message);
+                addToChunk(*this->exportBuckets.getUnchecked(bucketIndex - this->firstBucketIndex)->chunk, message);
             }
+        }
+
+        i = last + 1;
+    }
+}
+
+#if JUCE_DEBUG
 
-            // need to call it here?
-            //this->cachedSequence.updateMatchedPairs();
+static bool isMessageLess(const MidiMessage &first, const MidiMessage &second)
+{
+    if (first.getTimeStamp() != second.getTimeStamp())
+    { return first.getTimeStamp() < second.getTimeStamp(); }
+
+    if (first.getRawDataSize() != second.getRawDataSize())
+    { return first.getRawDataSize() < second.getRawDataSize(); }
+
+    return memcmp(first.getRawData(), second.getRawData(), size_t(first.getRawDataSize())) < 0;
+}
+
+bool MidiSequence::isExportConsistent() const
+{
+    Array<MidiMessage> expected;
+    this->exportEvents(expected);
+
+    Array<MidiMessage> actual;
+
+    for (auto bucket : this->exportBuckets)
+    {
+        if (bucket->chunk != nullptr)
+        {
+            actual.addArray(bucket->chunk->messages);
         }
+    }
+
+    if (expected.size() != actual.size())
+    { return false; }
+
+    // the order of the messages with equal timestamps may differ
+    // between the full and the ranged exports, so it's not compared
+    std::sort(expected.begin(), expected.end(), isMessageLess);
+    std::sort(actual.begin(), actual.end(), isMessageLess);
 
-        this->cachedSequence.updateMatchedPairs();
-        //this->cachedSequence.sort();
-        this->cacheIsOutdated = false;
+    for (int i = 0; i < expected.size(); ++i)
+    {
+        if (isMessageLess(expected.getReference(i), actual.getReference(i)) ||
+            isMessageLess(actual.getReference(i), expected.getReference(i)))
+        {
+            return false;
+        }
     }
 
-    return this->cachedSequence;
+    return true;
+}
+
+#endif
+
+void MidiSequence::invalidateExport(const Range<float> &beatRange)
+{
+    // everything is to be exported anyway
+    if (this->cacheIsOutdated)
+    { return; }
+
+    const int firstIndex = getBucketIndex(beatRange.getStart() - EXPORT_BUCKET_MARGIN_BEATS);
+    const int lastIndex = getBucketIndex(beatRange.getEnd() + EXPORT_BUCKET_MARGIN_BEATS);
+
+    if (this->exportBuckets.size() == 0)
+    {
+        this->firstBucketIndex = firstIndex;
+    }
+
+    // the buckets are kept contiguous, and the new ones are outdated
+    while (firstIndex < this->firstBucketIndex)
+    {
+        this->exportBuckets.insert(0, new ExportBucket());
+        --this->firstBucketIndex;
+    }
+
+    while (lastIndex >= this->firstBucketIndex + this->exportBuckets.size())
+    {
+        this->exportBuckets.add(new ExportBucket());
+    }
+
+    for (int i = firstIndex; i <= lastIndex; ++i)
+    {
+        this->exportBuckets.getUnchecked(i - this->firstBucketIndex)->isOutdated = true;
+    }
+
+    this->hasOutdatedBuckets = true;
+}
+
+void MidiSequence::exportEvents(Array<MidiMessage> &result) const
+{
+    for (auto event : this->midiEvents)
+    {
+        result.addArray(event->toMidiMessages());
+    }
+}
+
+void MidiSequence::exportEventsInRange(float startBeat, float endBeat, Array<MidiMessage> &result) const
+{
+    MidiEvent *const *const first = this->midiEvents.begin();
+    MidiEvent *const *const last = this->midiEvents.end();
+
+    const int firstInRange = int(std::lower_bound(first, last, startBeat,
+        [](const MidiEvent *event, float targetBeat)
+        {
+            return event->getBeat() < targetBeat;
+        }) - first);
+
+    // the previous event may have messages up to the next one,
+    // like automation ramps do
+    for (int i = jmax(0, firstInRange - 1); i < this->midiEvents.size(); ++i)
+    {
+        const MidiEvent *event = this->midiEvents.getUnchecked(i);
+
+        if (event->getBeat() >= endBeat)
+        { break; }
+
+        result.addArray(event->toMidiMessages());
+    }
+}
+
+Range<float> MidiSequence::getExportRange(const MidiEvent &event) const
+{
+    return Range<float>(event.getBeat(), event.getBeat());
+}
+
+//===----------------------------------------------------------------------===//
+// Binary chunks
+//===----------------------------------------------------------------------===//
+
+const MemoryBlock &MidiSequence::getBinaryChunk() const
+{
+    if (this->binaryChunkIsOutdated)
+    {
+        this->binaryChunk.reset();
+
+        {
+            MemoryOutputStream out(this->binaryChunk, false);
+            this->writeBinary(out);
+        }
+
+        this->binaryChunkIsOutdated = false;
+    }
+
+    return this->binaryChunk;
+}
+
+void MidiSequence::loadBinaryChunk(const void *data, size_t size)
+{
+    MemoryInputStream in(data, size, false);
+    this->readBinary(in);
+
+    // just loaded events would be written back the same way
+    this->binaryChunk = MemoryBlock(data, size);
+    this->binaryChunkIsOutdated = false;
 }
 
 //===----------------------------------------------------------------------===//
@@ -171,31 +587,36 @@ UndoStack *MidiSequence::getUndoStack()
 
 void MidiSequence::notifyEventChanged(const MidiEvent &oldEvent, const MidiEvent &newEvent)
 {
-    this->cacheIsOutdated = true;
+    this->binaryChunkIsOutdated = true;
+    this->invalidateExport(this->getExportRange(oldEvent));
+    this->invalidateExport(this->getExportRange(newEvent));
     this->eventDispatcher.dispatchChangeEvent(oldEvent, newEvent);
 }
 
 void MidiSequence::notifyEventAdded(const MidiEvent &event)
 {
-    this->cacheIsOutdated = true;
+    this->binaryChunkIsOutdated = true;
+    this->invalidateExport(this->getExportRange(event));
     this->eventDispatcher.dispatchAddEvent(event);
 }
 
 void MidiSequence::notifyEventRemoved(const MidiEvent &event)
 {
-    this->cacheIsOutdated = true;
+    this->binaryChunkIsOutdated = true;
+    this->invalidateExport(this->getExportRange(event));
     this->eventDispatcher.dispatchRemoveEvent(event);
 }
 
 void MidiSequence::notifyEventRemovedPostAction()
 {
-    this->cacheIsOutdated = true;
+    // the removed events have invalidated their export ranges already
     this->eventDispatcher.dispatchPostRemoveEvent(this);
 }
 
 void MidiSequence::notifySequenceChanged()
 {
     this->cacheIsOutdated = true;
+    this->binaryChunkIsOutdated = true;
     this->eventDispatcher.dispatchChangeTrackContent(&this->track);
 }
 
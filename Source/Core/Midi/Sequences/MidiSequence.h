@@ -49,8 +49,57 @@ public:
     // Import/export
     //===------------------------------------------------------------------===//
 
-    MidiMessageSequence exportMidi() const;
+    // An exported sequence is never changed after it's built, so it's
+    // shared by the export cache, the transport and the renderers.
+    // It is made of the export buckets' chunks, and the next export
+    // shares all the chunks, except for the ones of outdated buckets,
+    // so that an edit costs only the messages around it
+    struct ExportedMidi : public ReferenceCountedObject
+    {
+        ExportedMidi() : numEvents(0) {}
+
+        struct Chunk : public ReferenceCountedObject
+        {
+            Array<MidiMessage> messages;
+
+            // Contiguous copy of the messages' timestamps,
+            // used by the playback cursors for seeking and merging
+            Array<double> timeStamps;
+
+            typedef ReferenceCountedObjectPtr<Chunk> Ptr;
+        };
+
+        // Non-empty chunks in time order, and the index
+        // of every chunk's first message in the whole sequence
+        ReferenceCountedArray<Chunk> chunks;
+        Array<int> chunkStarts;
+        int numEvents;
+
+        int getNumEvents() const noexcept;
+        const MidiMessage &getMessage(int index) const noexcept;
+        double getTimeStamp(int index) const noexcept;
+
+        // Index of the first message with timestamp >= given one,
+        // or > given one, if skipEqual is set; numEvents if none
+        int findIndex(double timeStamp, bool skipEqual) const noexcept;
+
+        // For the ones who need a MidiMessageSequence, like MidiFile does
+        void addTo(MidiMessageSequence &target, double timeAdjustment) const;
+
+        typedef ReferenceCountedObjectPtr<ExportedMidi> Ptr;
+    };
+
+    ExportedMidi::Ptr exportMidi() const;
     virtual void importMidi(const MidiMessageSequence &sequence) = 0;
+
+    //===------------------------------------------------------------------===//
+    // Binary chunks
+    //===------------------------------------------------------------------===//
+
+    // The events in a compact form for the chunked project file; cached
+    // until the next change, so that saving encodes only the edited tracks
+    const MemoryBlock &getBinaryChunk() const;
+    void loadBinaryChunk(const void *data, size_t size);
     
     //===------------------------------------------------------------------===//
     // Track editing
@@ -129,6 +178,29 @@ protected:
     // clearQuick the arrays and don't send any notifications
     virtual void clearQuick() {}
 
+    // Appends all events' messages, in the order of events
+    virtual void exportEvents(Array<MidiMessage> &result) const;
+
+    // Appends the messages of the events, which may have messages within
+    // [startBeat, endBeat), in the order of events; the ones outside
+    // of the range are allowed, they are filtered out later
+    virtual void exportEventsInRange(float startBeat, float endBeat, Array<MidiMessage> &result) const;
+
+    // The beats range where the event's messages are, including the
+    // messages of other events which depend on this one
+    virtual Range<float> getExportRange(const MidiEvent &event) const;
+
+    virtual void writeBinary(OutputStream &out) const {}
+    virtual void readBinary(InputStream &in) {}
+
+    // Moves a single just changed event to its sorted place, shifting only
+    // the events between the old and the new places; returns the new index
+    int relocateEvent(int index);
+
+    // Takes out the events changed in a batch, given their indices before
+    // the change, sorts them and merges them back in one linear pass
+    void mergeChangedEvents(Array<int> &changedIndices);
+
     float lastEndBeat;
     float lastStartBeat;
     
@@ -139,9 +211,35 @@ protected:
     
 private:
 
-    mutable MidiMessageSequence cachedSequence;
+    // The exported messages are cached per beat ranges, so that
+    // an edit only makes the messages around it to be exported again
+    struct ExportBucket
+    {
+        ExportBucket() : isOutdated(true) {}
+        ExportedMidi::Chunk::Ptr chunk;
+        bool isOutdated;
+    };
+
+    mutable OwnedArray<ExportBucket> exportBuckets;
+    mutable int firstBucketIndex;
+    mutable bool hasOutdatedBuckets;
+
+    mutable ExportedMidi::Ptr cachedSequence;
+    mutable Array<MidiMessage> exportBuffer;
     mutable bool cacheIsOutdated;
 
+    void invalidateExport(const Range<float> &beatRange);
+    void exportAllBuckets() const;
+    void exportOutdatedBuckets() const;
+
+#if JUCE_DEBUG
+    // Checks that the buckets have the same messages as a full export would
+    bool isExportConsistent() const;
+#endif
+
+    mutable MemoryBlock binaryChunk;
+    mutable bool binaryChunkIsOutdated;
+
 private:
     
     WeakReference<MidiSequence>::Master masterReference;
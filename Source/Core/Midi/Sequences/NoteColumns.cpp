@@ -0,0 +1,225 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "NoteColumns.h"
+#include "Note.h"
+#include "Transport.h"
+
+#include <float.h>
+
+NoteColumns::NoteColumns() :
+    numLeaves(0),
+    treeIsOutdated(true)
+{
+}
+
+void NoteColumns::rebuild(const OwnedArray<MidiEvent> &sortedNotes)
+{
+    const int numNotes = sortedNotes.size();
+
+    this->clear();
+    this->keys.ensureStorageAllocated(numNotes);
+    this->beats.ensureStorageAllocated(numNotes);
+    this->lengths.ensureStorageAllocated(numNotes);
+    this->velocities.ensureStorageAllocated(numNotes);
+    this->ids.ensureStorageAllocated(numNotes);
+    this->notes.ensureStorageAllocated(numNotes);
+
+    for (int i = 0; i < numNotes; ++i)
+    {
+        Note *note = static_cast<Note *>(sortedNotes.getUnchecked(i));
+
+        this->keys.add(note->getKey());
+        this->beats.add(note->getBeat());
+        this->lengths.add(note->getLength());
+        this->velocities.add(note->getVelocity());
+        this->ids.add(note->getId());
+        this->notes.add(note);
+    }
+}
+
+void NoteColumns::clear()
+{
+    this->keys.clearQuick();
+    this->beats.clearQuick();
+    this->lengths.clearQuick();
+    this->velocities.clearQuick();
+    this->ids.clearQuick();
+    this->notes.clearQuick();
+    this->treeIsOutdated = true;
+}
+
+void NoteColumns::insert(int index, const Note &note)
+{
+    this->keys.insert(index, note.getKey());
+    this->beats.insert(index, note.getBeat());
+    this->lengths.insert(index, note.getLength());
+    this->velocities.insert(index, note.getVelocity());
+    this->ids.insert(index, note.getId());
+    this->notes.insert(index, const_cast<Note *>(&note));
+    this->treeIsOutdated = true;
+}
+
+void NoteColumns::remove(int index)
+{
+    this->keys.remove(index);
+    this->beats.remove(index);
+    this->lengths.remove(index);
+    this->velocities.remove(index);
+    this->ids.remove(index);
+    this->notes.remove(index);
+    this->treeIsOutdated = true;
+}
+
+void NoteColumns::update(int oldIndex, int newIndex, const Note &note)
+{
+    if (oldIndex != newIndex)
+    {
+        this->keys.move(oldIndex, newIndex);
+        this->beats.move(oldIndex, newIndex);
+        this->lengths.move(oldIndex, newIndex);
+        this->velocities.move(oldIndex, newIndex);
+        this->ids.move(oldIndex, newIndex);
+        this->notes.move(oldIndex, newIndex);
+    }
+
+    this->keys.set(newIndex, note.getKey());
+    this->beats.set(newIndex, note.getBeat());
+    this->lengths.set(newIndex, note.getLength());
+    this->velocities.set(newIndex, note.getVelocity());
+    this->ids.set(newIndex, note.getId());
+    this->notes.set(newIndex, const_cast<Note *>(&note));
+    this->treeIsOutdated = true;
+}
+
+float NoteColumns::getLastEndBeat() const noexcept
+{
+    this->rebuildTreeIfNeeded();
+    return (this->size() > 0) ? this->maxEndTree.getUnchecked(1) : 0.f;
+}
+
+int NoteColumns::indexOfFirstNoteAt(float beat) const noexcept
+{
+    const float *const first = this->beats.begin();
+    const float *const last = this->beats.end();
+    return int(std::lower_bound(first, last, beat) - first);
+}
+
+void NoteColumns::findNotesInRange(float startBeat, float endBeat, Array<int> &resultIndices) const
+{
+    const int endIndex = this->indexOfFirstNoteAt(endBeat);
+
+    if (endIndex == 0)
+    { return; }
+
+    this->rebuildTreeIfNeeded();
+    this->findNotesInRange(1, 0, this->numLeaves, startBeat, endIndex, resultIndices);
+}
+
+void NoteColumns::findNotesInRange(int node, int nodeStart, int nodeEnd,
+    float startBeat, int endIndex, Array<int> &resultIndices) const
+{
+    // nothing in this subtree ends after the range start,
+    // (zero-length notes exactly at the start still count)
+    if (nodeStart >= endIndex || this->maxEndTree.getUnchecked(node) < startBeat)
+    { return; }
+
+    if (nodeEnd - nodeStart == 1)
+    {
+        if (this->beats.getUnchecked(nodeStart) >= startBeat ||
+            this->getEndBeat(nodeStart) > startBeat)
+        {
+            resultIndices.add(nodeStart);
+        }
+
+        return;
+    }
+
+    const int nodeMiddle = (nodeStart + nodeEnd) / 2;
+    this->findNotesInRange(node * 2, nodeStart, nodeMiddle, startBeat, endIndex, resultIndices);
+    this->findNotesInRange(node * 2 + 1, nodeMiddle, nodeEnd, startBeat, endIndex, resultIndices);
+}
+
+void NoteColumns::rebuildTreeIfNeeded() const
+{
+    if (! this->treeIsOutdated)
+    { return; }
+
+    const int numNotes = this->size();
+
+    this->numLeaves = 1;
+    while (this->numLeaves < numNotes)
+    {
+        this->numLeaves *= 2;
+    }
+
+    this->maxEndTree.clearQuick();
+    this->maxEndTree.insertMultiple(0, -FLT_MAX, this->numLeaves * 2);
+    float *const tree = this->maxEndTree.getRawDataPointer();
+
+    for (int i = 0; i < numNotes; ++i)
+    {
+        tree[this->numLeaves + i] = this->getEndBeat(i);
+    }
+
+    for (int node = this->numLeaves - 1; node > 0; --node)
+    {
+        tree[node] = jmax(tree[node * 2], tree[node * 2 + 1]);
+    }
+
+    this->treeIsOutdated = false;
+}
+
+static inline void addNoteMessages(Array<MidiMessage> &result, int channel,
+    int key, float beat, float length, float velocity)
+{
+    MidiMessage noteOn(MidiMessage::noteOn(channel, key, velocity));
+    noteOn.setTimeStamp(beat * Transport::millisecondsPerBeat);
+    result.add(noteOn);
+
+    MidiMessage noteOff(MidiMessage::noteOff(channel, key));
+    noteOff.setTimeStamp((beat + length) * Transport::millisecondsPerBeat);
+    result.add(noteOff);
+}
+
+void NoteColumns::exportMessages(Array<MidiMessage> &result, int channel) const
+{
+    const int numNotes = this->size();
+    result.ensureStorageAllocated(result.size() + numNotes * 2);
+
+    const int *const keysData = this->keys.begin();
+    const float *const beatsData = this->beats.begin();
+    const float *const lengthsData = this->lengths.begin();
+    const float *const velocitiesData = this->velocities.begin();
+
+    for (int i = 0; i < numNotes; ++i)
+    {
+        addNoteMessages(result, channel, keysData[i], beatsData[i], lengthsData[i], velocitiesData[i]);
+    }
+}
+
+void NoteColumns::exportMessages(const Array<int> &indices, Array<MidiMessage> &result, int channel) const
+{
+    result.ensureStorageAllocated(result.size() + indices.size() * 2);
+
+    for (const int i : indices)
+    {
+        addNoteMessages(result, channel, this->keys.getUnchecked(i), this->beats.getUnchecked(i),
+                        this->lengths.getUnchecked(i), this->velocities.getUnchecked(i));
+    }
+}
@@ -0,0 +1,106 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+class Note;
+
+#include "MidiEvent.h"
+
+// A structure-of-arrays mirror of a piano sequence: keys, beats, lengths,
+// velocities and ids of all notes, sorted just like the sequence itself.
+// The notes themselves stay where they are, so that the UI and undo actions
+// could keep their pointers; this one is for the hot loops like export,
+// range queries and bulk transforms, which only need the plain numbers.
+// Range queries go through an implicit max-end tree over the sorted rows,
+// which only descends into the subtrees that may still have a note
+// sounding within the range, so a query takes O(log n + k).
+
+class NoteColumns
+{
+public:
+
+    NoteColumns();
+
+    void rebuild(const OwnedArray<MidiEvent> &sortedNotes);
+    void clear();
+
+    // Incremental updates, the index is the note's index in the sequence
+    void insert(int index, const Note &note);
+    void remove(int index);
+    void update(int oldIndex, int newIndex, const Note &note);
+
+    inline int size() const noexcept
+    { return this->beats.size(); }
+
+    inline int getKey(int index) const noexcept
+    { return this->keys.getUnchecked(index); }
+
+    inline float getBeat(int index) const noexcept
+    { return this->beats.getUnchecked(index); }
+
+    inline float getLength(int index) const noexcept
+    { return this->lengths.getUnchecked(index); }
+
+    inline float getEndBeat(int index) const noexcept
+    { return this->beats.getUnchecked(index) + this->lengths.getUnchecked(index); }
+
+    inline float getVelocity(int index) const noexcept
+    { return this->velocities.getUnchecked(index); }
+
+    inline MidiEvent::Id getId(int index) const noexcept
+    { return this->ids.getUnchecked(index); }
+
+    // A stable handle to the note object at a given index
+    inline Note *getNote(int index) const noexcept
+    { return this->notes.getUnchecked(index); }
+
+    float getLastEndBeat() const noexcept;
+
+    // The index of the first note which starts at or after a given beat
+    int indexOfFirstNoteAt(float beat) const noexcept;
+
+    // All notes starting or sounding within [startBeat, endBeat)
+    void findNotesInRange(float startBeat, float endBeat, Array<int> &resultIndices) const;
+
+    // Appends the note-on and note-off messages of every note
+    void exportMessages(Array<MidiMessage> &result, int channel) const;
+
+    // Same, for the given rows only, in the given order
+    void exportMessages(const Array<int> &indices, Array<MidiMessage> &result, int channel) const;
+
+private:
+
+    Array<int> keys;
+    Array<float> beats;
+    Array<float> lengths;
+    Array<float> velocities;
+    Array<MidiEvent::Id> ids;
+    Array<Note *> notes;
+
+    // leaves are the rows' end beats, every node is a max of its children;
+    // rebuilt lazily, since any insertion shifts all the rows after it
+    mutable Array<float> maxEndTree;
+    mutable int numLeaves;
+    mutable bool treeIsOutdated;
+
+    void rebuildTreeIfNeeded() const;
+    void findNotesInRange(int node, int nodeStart, int nodeEnd,
+        float startBeat, int endIndex, Array<int> &resultIndices) const;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NoteColumns)
+};
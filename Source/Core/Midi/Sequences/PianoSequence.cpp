@@ -27,12 +27,16 @@
 
 #include <float.h>
 
+// Larger batches are re-sorted by a single merge instead
+#define NOTES_TO_RELOCATE_ONE_BY_ONE 32
+
 // todo optimize data structures >_<
 // using std::dense_hash_map ?
 
 PianoSequence::PianoSequence(MidiTrack &track,
     ProjectEventDispatcher &dispatcher) :
-    MidiSequence(track, dispatcher)
+    MidiSequence(track, dispatcher),
+    columnsAreOutdated(true)
 {
 }
 
@@ -46,37 +50,45 @@ void PianoSequence::importMidi(const MidiMessageSequence &sequence)
     this->checkpoint();
     this->reset();
 
+    // instead of looking up a matching note-off for every note-on,
+    // keep the last pending note-on for every channel and key;
+    // just like in MidiMessageSequence::updateMatchedPairs,
+    // a repeated note-on ends the previous one
+    HeapBlock<const MidiMessage *> pendingNoteOns(16 * 128, true);
+    Array<Note> importedNotes;
+    importedNotes.ensureStorageAllocated(sequence.getNumEvents() / 2);
+
     for (int i = 0; i < sequence.getNumEvents(); ++i)
     {
-        const MidiMessage &messageOn = sequence.getEventPointer(i)->message;
+        const MidiMessage &message = sequence.getEventPointer(i)->message;
+        const bool isNoteOn = message.isNoteOn();
+
+        if (! isNoteOn && ! message.isNoteOff())
+        { continue; }
+
+        const MidiMessage *&pendingNoteOn = pendingNoteOns[(message.getChannel() - 1) * 128 + message.getNoteNumber()];
 
-        if (messageOn.isNoteOn())
+        if (pendingNoteOn != nullptr)
         {
+            const MidiMessage &messageOn = *pendingNoteOn;
             const double startTimestamp = messageOn.getTimeStamp() / MIDI_IMPORT_SCALE;
-            const int key = messageOn.getNoteNumber();
-            const float velocity = messageOn.getVelocity() / 128.f;
-            const float beat = float(startTimestamp);
+            const double endTimestamp = message.getTimeStamp() / MIDI_IMPORT_SCALE;
 
-            // ищем соответствующий note-off:
-            const int noteOffIndex = sequence.getIndexOfMatchingKeyUp(i);
-
-            if (noteOffIndex > 0)
+            if (endTimestamp > startTimestamp)
             {
-                const MidiMessage &messageOff = sequence.getEventPointer(noteOffIndex)->message;
-                const double endTimestamp = messageOff.getTimeStamp() / MIDI_IMPORT_SCALE;
-
-                if (endTimestamp > startTimestamp)
-                {
-                    const float length = float(endTimestamp - startTimestamp);
-
-                    // bottleneck warning!
-                    const Note note(this, key, beat, length, velocity);
-                    this->silentImport(note);
-                }
+                const int key = messageOn.getNoteNumber();
+                const float velocity = messageOn.getVelocity() / 128.f;
+                const float beat = float(startTimestamp);
+                const float length = float(endTimestamp - startTimestamp);
+                importedNotes.add(Note(this, key, beat, length, velocity));
             }
         }
+
+        pendingNoteOn = isNoteOn ? &message : nullptr;
     }
 
+    this->silentImportAll(importedNotes);
+
     this->notifyBeatRangeChanged();
     this->notifySequenceChanged();
 }
@@ -99,7 +111,40 @@ void PianoSequence::silentImport(const MidiEvent &eventToImport)
     // we need it to be sorted just because of sequence building performance?
     this->midiEvents.addSorted(*storedNote, storedNote); // bottleneck warning
     this->notesHashTable.set(note, storedNote);
+    this->insertIntoColumns(storedNote);
+
+    this->updateBeatRange(false);
+}
+
+void PianoSequence::silentImportAll(const Array<Note> &notesToImport)
+{
+    const int expectedNumNotes = this->midiEvents.size() + notesToImport.size();
+    this->midiEvents.ensureStorageAllocated(expectedNumNotes);
+
+    // HashMap only grows by doubling, one remap is much cheaper
+    if (this->notesHashTable.getNumSlots() < expectedNumNotes)
+    {
+        this->notesHashTable.remapTable(expectedNumNotes);
+    }
+
+    Array<int> importedIndices;
+    importedIndices.ensureStorageAllocated(notesToImport.size());
+
+    for (const auto &note : notesToImport)
+    {
+        if (this->notesHashTable.contains(note))
+        { continue; }
+
+        auto const storedNote = new Note(this);
+        *storedNote = note;
 
+        importedIndices.add(this->midiEvents.size());
+        this->midiEvents.add(storedNote); // merged later
+        this->notesHashTable.set(note, storedNote);
+    }
+
+    this->mergeChangedEvents(importedIndices);
+    this->columnsAreOutdated = true;
     this->updateBeatRange(false);
 }
 
@@ -122,6 +167,7 @@ MidiEvent *PianoSequence::insert(const Note &note, const bool undoable)
         
         this->midiEvents.addSorted(*storedNote, storedNote);
         this->notesHashTable.set(note, storedNote);
+        this->insertIntoColumns(storedNote);
 
         this->notifyEventAdded(*storedNote);
         this->updateBeatRange(true);
@@ -148,6 +194,7 @@ bool PianoSequence::remove(const Note &note, const bool undoable)
             this->notifyEventRemoved(*matchingNote);
             
             const int matchingNoteIndex = this->indexOfSorted(matchingNote);
+            this->removeFromColumns(matchingNoteIndex);
             this->midiEvents.remove(matchingNoteIndex, true);
             
             this->notesHashTable.remove(note);
@@ -177,13 +224,14 @@ bool PianoSequence::change(const Note &note,
     {
         if (Note *matchingNote = this->notesHashTable[note])
         {
-            // fixme - remove and addSorted instead?
+            const int oldIndex = this->indexOfSorted(matchingNote);
+
             (*matchingNote) = newNote;
 
             this->notesHashTable.set(newNote, matchingNote);
 
-            // fixme - remove and addSorted instead?
-            this->sort();
+            const int newIndex = this->relocateEvent(oldIndex);
+            this->updateColumns(oldIndex, newIndex, *matchingNote);
 
             this->notifyEventChanged(note, *matchingNote);
             this->updateBeatRange(true);
@@ -207,17 +255,23 @@ bool PianoSequence::insertGroup(Array<Note> &notes, bool undoable)
     }
     else
     {
+        this->columnsAreOutdated = true;
+
+        Array<int> insertedIndices;
+
         for (int i = 0; i < notes.size(); ++i)
         {
             const Note &note = notes.getUnchecked(i);
             auto storedNote = new Note(this, note);
             
-            this->midiEvents.add(storedNote); // sorted later
+            insertedIndices.add(this->midiEvents.size());
+            this->midiEvents.add(storedNote); // merged later
             this->notesHashTable.set(note, storedNote);
             this->notifyEventAdded(*storedNote);
         }
 
-        this->sort();
+        this->mergeChangedEvents(insertedIndices);
+        this->columnsAreOutdated = true;
         this->updateBeatRange(true);
     }
 
@@ -243,6 +297,7 @@ bool PianoSequence::removeGroup(Array<Note> &notes, bool undoable)
                 this->notifyEventRemoved(*matchingNote);
                 
                 const int matchingNoteIndex = this->indexOfSorted(matchingNote);
+                this->removeFromColumns(matchingNoteIndex);
                 this->midiEvents.remove(matchingNoteIndex, true);
                 //this->midiEvents.removeObject(matchingNote);
                 
@@ -270,7 +325,7 @@ bool PianoSequence::changeGroup(Array<Note> &notesBefore,
                                                                  notesBefore,
                                                                  notesAfter));
     }
-    else
+    else if (notesBefore.size() <= NOTES_TO_RELOCATE_ONE_BY_ONE)
     {
         for (int i = 0; i < notesBefore.size(); ++i)
         {
@@ -279,6 +334,46 @@ bool PianoSequence::changeGroup(Array<Note> &notesBefore,
 
             if (Note *matchingNote = this->notesHashTable[note])
             {
+                const int oldIndex = this->indexOfSorted(matchingNote);
+
+                (*matchingNote) = newNote;
+
+                this->notesHashTable.set(newNote, matchingNote);
+
+                const int newIndex = this->relocateEvent(oldIndex);
+                this->updateColumns(oldIndex, newIndex, *matchingNote);
+                this->notifyEventChanged(note, *matchingNote);
+            }
+        }
+
+        this->updateBeatRange(true);
+    }
+    else
+    {
+        // all indices have to be found while the array is still sorted
+        Array<int> changedIndices;
+        Array<Note *> matchingNotes;
+
+        for (int i = 0; i < notesBefore.size(); ++i)
+        {
+            Note *matchingNote = this->notesHashTable[notesBefore.getUnchecked(i)];
+            matchingNotes.add(matchingNote);
+
+            if (matchingNote != nullptr)
+            {
+                changedIndices.add(this->indexOfSorted(matchingNote));
+            }
+        }
+
+        this->columnsAreOutdated = true;
+
+        for (int i = 0; i < notesBefore.size(); ++i)
+        {
+            if (Note *matchingNote = matchingNotes.getUnchecked(i))
+            {
+                const Note &note = notesBefore.getUnchecked(i);
+                const Note &newNote = notesAfter.getUnchecked(i);
+
                 (*matchingNote) = newNote;
 
                 this->notesHashTable.set(newNote, matchingNote);
@@ -286,7 +381,8 @@ bool PianoSequence::changeGroup(Array<Note> &notesBefore,
             }
         }
 
-        this->sort();
+        this->mergeChangedEvents(changedIndices);
+        this->columnsAreOutdated = true;
         this->updateBeatRange(true);
     }
 
@@ -299,23 +395,22 @@ bool PianoSequence::changeGroup(Array<Note> &notesBefore,
 
 void PianoSequence::transposeAll(int keyDelta, bool shouldCheckpoint)
 {
-    if (this->midiEvents.size() == 0)
+    const NoteColumns &notes = this->getColumns();
+
+    if (notes.size() == 0)
     {
         return;
     }
 
     Array<Note> groupBefore, groupAfter;
+    groupBefore.ensureStorageAllocated(notes.size());
+    groupAfter.ensureStorageAllocated(notes.size());
 
-    for (int i = 0; i < this->midiEvents.size(); ++i)
+    for (int i = 0; i < notes.size(); ++i)
     {
-        if (Note *n = dynamic_cast<Note *>(this->midiEvents.getUnchecked(i)))
-        {
-            Note n1 = *n;
-            Note n2 = n1.withDeltaKey(keyDelta);
-
-            groupBefore.add(n1);
-            groupAfter.add(n2);
-        }
+        const Note &n = *notes.getNote(i);
+        groupBefore.add(n);
+        groupAfter.add(n.withDeltaKey(keyDelta));
     }
 
     if (shouldCheckpoint)
@@ -347,6 +442,55 @@ float PianoSequence::getLastBeat() const
     return note.getBeat() + note.getLength();
 }
 
+const NoteColumns &PianoSequence::getColumns() const
+{
+    if (this->columnsAreOutdated)
+    {
+        this->columns.rebuild(this->midiEvents);
+        this->columnsAreOutdated = false;
+    }
+
+    return this->columns;
+}
+
+void PianoSequence::insertIntoColumns(Note *storedNote)
+{
+    if (! this->columnsAreOutdated)
+    {
+        this->columns.insert(this->indexOfSorted(storedNote), *storedNote);
+    }
+}
+
+void PianoSequence::removeFromColumns(int noteIndex)
+{
+    if (! this->columnsAreOutdated)
+    {
+        this->columns.remove(noteIndex);
+    }
+}
+
+void PianoSequence::updateColumns(int oldIndex, int newIndex, const Note &note)
+{
+    if (! this->columnsAreOutdated)
+    {
+        this->columns.update(oldIndex, newIndex, note);
+    }
+}
+
+void PianoSequence::findNotesInRange(float startBeat, float endBeat, Array<Note *> &result) const
+{
+    const NoteColumns &notes = this->getColumns();
+
+    Array<int> indices;
+    notes.findNotesInRange(startBeat, endBeat, indices);
+    result.ensureStorageAllocated(result.size() + indices.size());
+
+    for (const int index : indices)
+    {
+        result.add(notes.getNote(index));
+    }
+}
+
 
 //===----------------------------------------------------------------------===//
 // Serializable
@@ -395,6 +539,44 @@ void PianoSequence::deserialize(const XmlElement &xml)
     }
 
     this->sort();
+    this->columnsAreOutdated = true;
+    this->updateBeatRange(false);
+    this->notifySequenceChanged();
+}
+
+void PianoSequence::writeBinary(OutputStream &out) const
+{
+    out.writeCompressedInt(this->midiEvents.size());
+
+    for (int i = 0; i < this->midiEvents.size(); ++i)
+    {
+        const auto event = static_cast<const Note *>(this->midiEvents.getUnchecked(i));
+        event->writeBinary(out);
+    }
+}
+
+void PianoSequence::readBinary(InputStream &in)
+{
+    this->clearQuick();
+
+    const int numEvents = jmax(0, in.readCompressedInt());
+    this->midiEvents.ensureStorageAllocated(numEvents);
+
+    if (this->notesHashTable.getNumSlots() < numEvents)
+    {
+        this->notesHashTable.remapTable(numEvents);
+    }
+
+    for (int i = 0; i < numEvents && ! in.isExhausted(); ++i)
+    {
+        auto event = new Note(this);
+        event->readBinary(in);
+        this->midiEvents.add(event);
+        this->notesHashTable.set(*event, event);
+    }
+
+    this->sort();
+    this->columnsAreOutdated = true;
     this->updateBeatRange(false);
     this->notifySequenceChanged();
 }
@@ -409,4 +591,26 @@ void PianoSequence::clearQuick()
 {
     this->midiEvents.clearQuick(true);
     this->notesHashTable.clear();
+    this->columns.clear();
+    this->columnsAreOutdated = false;
+}
+
+void PianoSequence::exportEvents(Array<MidiMessage> &result) const
+{
+    this->getColumns().exportMessages(result, this->getChannel());
+}
+
+void PianoSequence::exportEventsInRange(float startBeat, float endBeat, Array<MidiMessage> &result) const
+{
+    const NoteColumns &notes = this->getColumns();
+
+    Array<int> indices;
+    notes.findNotesInRange(startBeat, endBeat, indices);
+    notes.exportMessages(indices, result, this->getChannel());
+}
+
+Range<float> PianoSequence::getExportRange(const MidiEvent &event) const
+{
+    const Note &note = static_cast<const Note &>(event);
+    return Range<float>(note.getBeat(), note.getBeat() + note.getLength());
 }
@@ -19,6 +19,7 @@
 
 #include "MidiSequence.h"
 #include "Note.h"
+#include "NoteColumns.h"
 
 class PianoRoll;
 
@@ -41,6 +42,10 @@ public:
     //===------------------------------------------------------------------===//
 
     void silentImport(const MidiEvent &eventToImport) override;
+
+    // A bulk version of silentImport: skips duplicates, then sorts and
+    // indexes all the notes at once. Doesn't notify anybody either.
+    void silentImportAll(const Array<Note> &notesToImport);
     
     
     MidiEvent *insert(const Note &note, const bool undoable);
@@ -70,6 +75,12 @@ public:
     //===------------------------------------------------------------------===//
     
     float getLastBeat() const override; // overriding to set beat+length
+
+    // Contiguous copies of all notes' parameters, for the hot loops
+    const NoteColumns &getColumns() const;
+
+    // Stable handles to all notes starting or sounding within [startBeat, endBeat)
+    void findNotesInRange(float startBeat, float endBeat, Array<Note *> &result) const;
     
     
     //===------------------------------------------------------------------===//
@@ -85,6 +96,11 @@ public:
 protected:
 
     void clearQuick() override;
+    void exportEvents(Array<MidiMessage> &result) const override;
+    void exportEventsInRange(float startBeat, float endBeat, Array<MidiMessage> &result) const override;
+    Range<float> getExportRange(const MidiEvent &event) const override;
+    void writeBinary(OutputStream &out) const override;
+    void readBinary(InputStream &in) override;
 
 private:
 
@@ -92,6 +108,15 @@ private:
     // todo вот прям быстрый? замени на dense_hash_map или flat_hash_map
     HashMap<Note, Note *, NoteHashFunction> notesHashTable;
 
+    // updated in place by single note edits,
+    // and rebuilt lazily after group edits
+    mutable NoteColumns columns;
+    mutable bool columnsAreOutdated;
+
+    void insertIntoColumns(Note *storedNote);
+    void removeFromColumns(int noteIndex);
+    void updateColumns(int oldIndex, int newIndex, const Note &note);
+
 private:
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PianoSequence);
@@ -0,0 +1,169 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "Common.h"
+#include "ChunkedProjectFile.h"
+
+static const int kMagicNumber =
+    static_cast<int>(ByteOrder::littleEndianInt("PRC:"));
+
+static const int kVersion = 1;
+
+// magic, version and number of chunks
+static const int64 kHeaderSize = 12;
+
+static const String kProjectChunkId = "project";
+
+ChunkedProjectFile::ChunkedProjectFile(const File &file) :
+    mappedFile(new MemoryMappedFile(file, MemoryMappedFile::readOnly, false))
+{
+    const int64 fileSize = int64(this->mappedFile->getSize());
+
+    if (this->mappedFile->getData() == nullptr || fileSize < kHeaderSize)
+    {
+        this->mappedFile = nullptr;
+        return;
+    }
+
+    MemoryInputStream in(this->mappedFile->getData(), size_t(fileSize), false);
+
+    if (in.readInt() != kMagicNumber || in.readInt() != kVersion)
+    {
+        this->mappedFile = nullptr;
+        return;
+    }
+
+    const int numChunks = in.readInt();
+
+    for (int i = 0; i < numChunks && ! in.isExhausted(); ++i)
+    {
+        const String chunkId = in.readString();
+        Chunk chunk;
+        chunk.offset = in.readInt64();
+        chunk.size = in.readInt64();
+
+        if (chunk.offset < 0 || chunk.size < 0 || chunk.offset + chunk.size > fileSize)
+        {
+            this->chunks.clear();
+            this->mappedFile = nullptr;
+            return;
+        }
+
+        this->chunks.set(chunkId, chunk);
+    }
+}
+
+bool ChunkedProjectFile::isValid() const noexcept
+{
+    return (this->mappedFile != nullptr);
+}
+
+XmlElement *ChunkedProjectFile::createProjectXml() const
+{
+    size_t size = 0;
+    const void *data = this->getChunkData(kProjectChunkId, size);
+
+    if (data == nullptr)
+    { return nullptr; }
+
+    MemoryInputStream input(data, size, false);
+    GZIPDecompressorInputStream gzInput(input);
+    return XmlDocument::parse(gzInput.readEntireStreamAsString());
+}
+
+const void *ChunkedProjectFile::getChunkData(const String &chunkId, size_t &outSize) const
+{
+    if (this->mappedFile == nullptr || ! this->chunks.contains(chunkId))
+    { return nullptr; }
+
+    const Chunk chunk(this->chunks[chunkId]);
+    outSize = size_t(chunk.size);
+    return static_cast<const char *>(this->mappedFile->getData()) + chunk.offset;
+}
+
+bool ChunkedProjectFile::isChunkedFile(const File &file)
+{
+    FileInputStream fileStream(file);
+    return fileStream.openedOk() && (fileStream.readInt() == kMagicNumber);
+}
+
+bool ChunkedProjectFile::save(const File &file, const XmlElement &projectXml,
+    const EventChunkWriter &eventChunks)
+{
+    MemoryBlock projectChunk;
+
+    {
+        MemoryOutputStream memOut(projectChunk, false);
+        GZIPCompressorOutputStream compressedOut(&memOut, 1, false);
+        projectXml.writeToStream(compressedOut, "", false, true, "UTF-8", 512);
+        compressedOut.flush();
+    }
+
+    StringArray ids(kProjectChunkId);
+    ids.addArray(eventChunks.chunkIds);
+
+    Array<const MemoryBlock *> blocks;
+    blocks.add(&projectChunk);
+    blocks.addArray(eventChunks.chunks);
+
+    // the table of contents goes first, so all offsets are known in advance
+    int64 offset = kHeaderSize;
+
+    for (const auto &id : ids)
+    {
+        offset += int64(id.getNumBytesAsUTF8()) + 1 + 16;
+    }
+
+    TemporaryFile tempFile(file);
+    ScopedPointer<OutputStream> out(tempFile.getFile().createOutputStream());
+
+    if (out == nullptr)
+    {
+        Logger::writeToLog("ChunkedProjectFile::save failed");
+        return false;
+    }
+
+    out->writeInt(kMagicNumber);
+    out->writeInt(kVersion);
+    out->writeInt(ids.size());
+
+    for (int i = 0; i < ids.size(); ++i)
+    {
+        const int64 size = int64(blocks.getUnchecked(i)->getSize());
+        out->writeString(ids[i]);
+        out->writeInt64(offset);
+        out->writeInt64(size);
+        offset += size;
+    }
+
+    for (auto block : blocks)
+    {
+        out->write(block->getData(), block->getSize());
+    }
+
+    out->flush();
+    out = nullptr;
+
+    if (tempFile.overwriteTargetFileWithTemporary())
+    {
+        return true;
+    }
+
+    Logger::writeToLog("ChunkedProjectFile::save failed overwriteTargetFileWithTemporary");
+    return false;
+}
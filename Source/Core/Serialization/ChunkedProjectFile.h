@@ -0,0 +1,78 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+// The project file made of chunks, which are listed in a table of contents
+// at the beginning: the project xml without the tracks' events,
+// and one chunk per track with its events in a compact binary form.
+// The chunks are read right from the memory-mapped file.
+
+// Collects the tracks' event chunks while the project is serialized;
+// the blocks are owned by the sequences and must outlive the save
+class EventChunkWriter
+{
+public:
+
+    void addChunk(const String &chunkId, const MemoryBlock &data)
+    {
+        this->chunkIds.add(chunkId);
+        this->chunks.add(&data);
+    }
+
+private:
+
+    StringArray chunkIds;
+    Array<const MemoryBlock *> chunks;
+
+    friend class ChunkedProjectFile;
+
+};
+
+class ChunkedProjectFile
+{
+public:
+
+    explicit ChunkedProjectFile(const File &file);
+
+    bool isValid() const noexcept;
+
+    XmlElement *createProjectXml() const;
+
+    // Returns nullptr, if there's no such chunk;
+    // the data is valid while this object exists
+    const void *getChunkData(const String &chunkId, size_t &outSize) const;
+
+    static bool isChunkedFile(const File &file);
+
+    static bool save(const File &file, const XmlElement &projectXml,
+                     const EventChunkWriter &eventChunks);
+
+private:
+
+    struct Chunk
+    {
+        int64 offset;
+        int64 size;
+    };
+
+    ScopedPointer<MemoryMappedFile> mappedFile;
+    HashMap<String, Chunk> chunks;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ChunkedProjectFile)
+};
@@ -221,44 +221,75 @@ static inline std::string decodeBase64(const std::string &encoded_string)
     return ret;
 }
 
-static inline MemoryBlock doXor(const MemoryBlock &input)
+// The key's length is a multiple of the word size, so the whole key
+// is applied word by word, which the compiler can vectorise
+static inline void applyXor(void *data, size_t size)
 {
-    MemoryBlock encoded;
+    uint8 *bytes = static_cast<uint8 *>(data);
+    const uint8 *key = reinterpret_cast<const uint8 *>(kXorKey.data());
+    const size_t keySize = kXorKey.length();
+    jassert(keySize % sizeof(uint64) == 0);
+
+    size_t i = 0;
+
+    for (; i + keySize <= size; i += keySize)
+    {
+        for (size_t k = 0; k < keySize; k += sizeof(uint64))
+        {
+            uint64 word, keyWord;
+            memcpy(&word, bytes + i + k, sizeof(uint64));
+            memcpy(&keyWord, key + k, sizeof(uint64));
+            word ^= keyWord;
+            memcpy(bytes + i + k, &word, sizeof(uint64));
+        }
+    }
 
-    for (unsigned long i = 0; i < input.getSize(); i++)
+    for (; i < size; ++i)
     {
-        char orig = input[i];
-        char key = kXorKey[i % kXorKey.length()];
-        char xorChar = orig ^ key;
-        encoded.append(&xorChar, 1);
+        bytes[i] ^= key[i % keySize];
     }
+}
 
+static inline MemoryBlock doXor(const MemoryBlock &input)
+{
+    MemoryBlock encoded(input);
+    applyXor(encoded.getData(), encoded.getSize());
     return encoded;
 }
 
-static inline MemoryBlock compress(const String &str)
+static inline MemoryBlock compress(const void *data, size_t size)
 {
     MemoryOutputStream memOut;
     GZIPCompressorOutputStream compressMemOut(&memOut, 1, false);
-    compressMemOut.write(str.toRawUTF8(), str.getNumBytesAsUTF8());
+    compressMemOut.write(data, size);
     compressMemOut.flush();
     return MemoryBlock(memOut.getData(), memOut.getDataSize());
 }
 
-static inline String decompress(const MemoryBlock &str)
+static inline MemoryBlock compress(const String &str)
+{
+    return compress(str.toRawUTF8(), str.getNumBytesAsUTF8());
+}
+
+static inline MemoryBlock decompressData(const void *data, size_t size)
 {
-    MemoryInputStream input(str.getData(), str.getSize(), false);
+    MemoryInputStream input(data, size, false);
     GZIPDecompressorInputStream gzInput(input);
-    MemoryBlock decompressedData(0, true);
-    MemoryBlock buf(512);
 
-    while (!gzInput.isExhausted())
-    {
-        const int data = gzInput.read(buf.getData(), 512);
-        decompressedData.append(buf.getData(), data);
-    }
+    // grows geometrically, unlike appending to a memory block
+    MemoryOutputStream decompressedData;
+    decompressedData.writeFromInputStream(gzInput, -1);
+    return decompressedData.getMemoryBlock();
+}
 
-    return decompressedData.toString();
+static inline String decompress(const void *data, size_t size)
+{
+    return decompressData(data, size).toString();
+}
+
+static inline String decompress(const MemoryBlock &str)
+{
+    return decompress(str.getData(), str.getSize());
 }
 
 String DataEncoder::obfuscateString(const String &buffer)
@@ -279,6 +310,20 @@ String DataEncoder::deobfuscateString(const String &buffer)
     return uncompressed;
 }
 
+MemoryBlock DataEncoder::obfuscateData(const MemoryBlock &buffer)
+{
+    MemoryBlock compressed(compress(buffer.getData(), buffer.getSize()));
+    applyXor(compressed.getData(), compressed.getSize());
+    return compressed;
+}
+
+MemoryBlock DataEncoder::deobfuscateData(const MemoryBlock &buffer)
+{
+    MemoryBlock compressed(buffer);
+    applyXor(compressed.getData(), compressed.getSize());
+    return decompressData(compressed.getData(), compressed.getSize());
+}
+
 bool DataEncoder::saveObfuscated(const File &file, XmlElement *xml)
 {
 // Writes as plain text for debugging purposes:
@@ -24,6 +24,10 @@ public:
     static String obfuscateString(const String &buffer);
     static String deobfuscateString(const String &buffer);
 
+    // Same as above, but binary, without the base64 overhead
+    static MemoryBlock obfuscateData(const MemoryBlock &buffer);
+    static MemoryBlock deobfuscateData(const MemoryBlock &buffer);
+
     static bool saveObfuscated(const File &file, XmlElement *xml);
     static XmlElement *loadObfuscated(const File &file);
 
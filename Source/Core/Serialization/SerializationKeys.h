@@ -97,6 +97,12 @@ namespace Serialization
         static const String openGLState = "OpenGL";
         static const String enabledState = "Enabled";
         static const String disabledState = "Disabled";
+        static const String blockBasedPlayback = "BlockBasedPlayback";
+        static const String renderBlockSize = "RenderBlockSize";
+        static const String renderBitDepth = "RenderBitDepth";
+        static const String renderDither = "RenderDither";
+        static const String renderTargetLoudness = "RenderTargetLoudness";
+        static const String renderTruePeakCeiling = "RenderTruePeakCeiling";
 
         static const String pluginManager = "PluginManager";
         static const String audioSettings = "AudioSettings";
@@ -283,6 +289,7 @@ namespace Serialization
         static const String deltaIntParam = "IntParam";
         static const String deltaStringParam = "StringParam";
         static const String deltaType = "Type";
+        static const String deltaEvents = "Events";
 
         static const String headStateDelta = "HeadState";
     }  // namespace VCS
@@ -27,7 +27,11 @@
 
 void Supervisor::track(const String &key)
 {
-    App::Helio()->getSupervisor()->trackActivity(key);
+    // there is no supervisor in a command-line mode
+    if (Supervisor *supervisor = App::Helio()->getSupervisor())
+    {
+        supervisor->trackActivity(key);
+    }
 }
 
 Supervisor::Supervisor()
@@ -19,6 +19,7 @@
 #include "AutomationTrackTreeItem.h"
 #include "AutomationSequence.h"
 #include "AutoLayerDeltas.h"
+#include "EventDeltas.h"
 #include "TreeItemChildrenSerializer.h"
 #include "Icons.h"
 #include "TreeItemComponentCompact.h"
@@ -186,6 +187,16 @@ void AutomationTrackTreeItem::resetStateTo(const VCS::TrackedItem &newState)
 //===----------------------------------------------------------------------===//
 
 XmlElement *AutomationTrackTreeItem::serialize() const
+{
+    return this->serializeTrack(nullptr);
+}
+
+XmlElement *AutomationTrackTreeItem::serializeWithEventChunks(EventChunkWriter &eventChunks) const
+{
+    return this->serializeTrack(&eventChunks);
+}
+
+XmlElement *AutomationTrackTreeItem::serializeTrack(EventChunkWriter *eventChunks) const
 {
     auto xml = new XmlElement(Serialization::Core::treeItem);
 
@@ -196,10 +207,10 @@ XmlElement *AutomationTrackTreeItem::serialize() const
 
     this->serializeTrackProperties(*xml);
 
-    xml->addChildElement(this->layer->serialize());
+    xml->addChildElement(this->serializeSequence(Serialization::Core::automation, eventChunks));
     xml->addChildElement(this->pattern->serialize());
 
-    TreeItemChildrenSerializer::serializeChildren(*this, *xml);
+    TreeItemChildrenSerializer::serializeChildren(*this, *xml, eventChunks);
 
     return xml;
 }
@@ -270,15 +281,7 @@ XmlElement *AutomationTrackTreeItem::serializeControllerDelta() const
 
 XmlElement *AutomationTrackTreeItem::serializeEventsDelta() const
 {
-    auto xml = new XmlElement(AutoLayerDeltas::eventsAdded);
-
-    for (int i = 0; i < this->getSequence()->size(); ++i)
-    {
-        const MidiEvent *event = this->getSequence()->getUnchecked(i);
-        xml->addChildElement(event->serialize());
-    }
-
-    return xml;
+    return EventDeltas::serialize(*this->getSequence(), AutoLayerDeltas::eventsAdded);
 }
 
 
@@ -334,8 +337,23 @@ void AutomationTrackTreeItem::resetEventsDelta(const XmlElement *state)
     this->reset();
     this->getSequence()->reset();
 
-    forEachXmlChildElementWithTagName(*state, e, Serialization::Core::event)
+    int numEvents = 0;
+    ScopedPointer<InputStream> in(EventDeltas::createEventsStream(*state, numEvents));
+
+    if (in != nullptr)
     {
-        this->getSequence()->silentImport(AutomationEvent(this->getSequence()).withParameters(*e));
+        for (int i = 0; i < numEvents && ! in->isExhausted(); ++i)
+        {
+            AutomationEvent event(this->getSequence());
+            event.readBinary(*in);
+            this->getSequence()->silentImport(event);
+        }
+    }
+    else
+    {
+        forEachXmlChildElementWithTagName(*state, e, Serialization::Core::event)
+        {
+            this->getSequence()->silentImport(AutomationEvent(this->getSequence()).withParameters(*e));
+        }
     }
 }
@@ -52,6 +52,8 @@ public:
 
     XmlElement *serialize() const override;
 
+    XmlElement *serializeWithEventChunks(EventChunkWriter &eventChunks) const override;
+
     void deserialize(const XmlElement &xml) override;
 
 
@@ -85,6 +87,8 @@ public:
 
 private:
 
+    XmlElement *serializeTrack(EventChunkWriter *eventChunks) const;
+
     ScopedPointer<VCS::AutomationLayerDiffLogic> vcsDiffLogic;
 
     OwnedArray<VCS::Delta> deltas;
@@ -21,6 +21,7 @@
 
 #include "TreeItemChildrenSerializer.h"
 #include "ProjectTreeItem.h"
+#include "ChunkedProjectFile.h"
 #include "MainLayout.h"
 #include "AudioCore.h"
 #include "Icons.h"
@@ -450,6 +451,18 @@ ProjectTreeItem *MidiTrackTreeItem::getProject() const
     return this->lastFoundParent;
 }
 
+XmlElement *MidiTrackTreeItem::serializeSequence(const String &sequenceTag,
+    EventChunkWriter *eventChunks) const
+{
+    if (eventChunks != nullptr)
+    {
+        eventChunks->addChunk(this->getTrackId().toString(), this->layer->getBinaryChunk());
+        return new XmlElement(sequenceTag);
+    }
+
+    return this->layer->serialize();
+}
+
 
 //===----------------------------------------------------------------------===//
 // Dragging
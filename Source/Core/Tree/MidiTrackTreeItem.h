@@ -119,6 +119,9 @@ public:
 
 protected:
 
+    // An empty sequence node, if the events go to the chunk writer
+    XmlElement *serializeSequence(const String &sequenceTag, EventChunkWriter *eventChunks) const;
+
     ProjectTreeItem *lastFoundParent;
 
     ScopedPointer<MidiSequence> layer;
@@ -31,6 +31,7 @@
 #include "Delta.h"
 #include "PatternDeltas.h"
 #include "PianoLayerDeltas.h"
+#include "EventDeltas.h"
 #include "MidiTrackDeltas.h"
 #include "PianoLayerDiffLogic.h"
 
@@ -200,6 +201,16 @@ void PianoTrackTreeItem::resetStateTo(const VCS::TrackedItem &newState)
 //===----------------------------------------------------------------------===//
 
 XmlElement *PianoTrackTreeItem::serialize() const
+{
+    return this->serializeTrack(nullptr);
+}
+
+XmlElement *PianoTrackTreeItem::serializeWithEventChunks(EventChunkWriter &eventChunks) const
+{
+    return this->serializeTrack(&eventChunks);
+}
+
+XmlElement *PianoTrackTreeItem::serializeTrack(EventChunkWriter *eventChunks) const
 {
     auto xml = new XmlElement(Serialization::Core::treeItem);
 
@@ -210,10 +221,10 @@ XmlElement *PianoTrackTreeItem::serialize() const
 
     this->serializeTrackProperties(*xml);
 
-    xml->addChildElement(this->layer->serialize());
+    xml->addChildElement(this->serializeSequence(Serialization::Core::track, eventChunks));
     xml->addChildElement(this->pattern->serialize());
 
-    TreeItemChildrenSerializer::serializeChildren(*this, *xml);
+    TreeItemChildrenSerializer::serializeChildren(*this, *xml, eventChunks);
 
     return xml;
 }
@@ -275,16 +286,7 @@ XmlElement *PianoTrackTreeItem::serializeInstrumentDelta() const
 
 XmlElement *PianoTrackTreeItem::serializeEventsDelta() const
 {
-    auto xml = new XmlElement(PianoLayerDeltas::notesAdded);
-
-    // да, дублируется сериализация :( причем 2 раза
-    for (int i = 0; i < this->getSequence()->size(); ++i)
-    {
-        const MidiEvent *event = this->getSequence()->getUnchecked(i);
-        xml->addChildElement(event->serialize());
-    }
-
-    return xml;
+    return EventDeltas::serialize(*this->getSequence(), PianoLayerDeltas::notesAdded);
 }
 
 
@@ -333,10 +335,30 @@ void PianoTrackTreeItem::resetEventsDelta(const XmlElement *state)
     //this->reset(); // TODO test
     this->getSequence()->reset();
 
-    forEachXmlChildElementWithTagName(*state, e, Serialization::Core::note)
+    Array<Note> notes;
+    int numNotes = 0;
+    ScopedPointer<InputStream> in(EventDeltas::createEventsStream(*state, numNotes));
+
+    if (in != nullptr)
+    {
+        notes.ensureStorageAllocated(numNotes);
+
+        for (int i = 0; i < numNotes && ! in->isExhausted(); ++i)
+        {
+            Note note(this->getSequence());
+            note.readBinary(*in);
+            notes.add(note);
+        }
+    }
+    else
     {
-        this->getSequence()->silentImport(Note(this->getSequence()).withParameters(*e));
+        forEachXmlChildElementWithTagName(*state, e, Serialization::Core::note)
+        {
+            notes.add(Note(this->getSequence()).withParameters(*e));
+        }
     }
+
+    static_cast<PianoSequence *>(this->getSequence())->silentImportAll(notes);
 }
 
 // TODO manage clip deltas
@@ -51,6 +51,8 @@ public:
 
     XmlElement *serialize() const override;
 
+    XmlElement *serializeWithEventChunks(EventChunkWriter &eventChunks) const override;
+
     void deserialize(const XmlElement &xml) override;
 
 
@@ -81,6 +83,8 @@ public:
 
 private:
 
+    XmlElement *serializeTrack(EventChunkWriter *eventChunks) const;
+
     ScopedPointer<VCS::PianoLayerDiffLogic> vcsDiffLogic;
 
     OwnedArray<VCS::Delta> deltas;
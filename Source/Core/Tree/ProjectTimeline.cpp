@@ -20,6 +20,7 @@
 #include "AnnotationsSequence.h"
 #include "TimeSignaturesSequence.h"
 #include "ProjectTimelineDeltas.h"
+#include "EventDeltas.h"
 #include "ProjectTreeItem.h"
 #include "Pattern.h"
 #include "Icons.h"
@@ -306,15 +307,7 @@ void ProjectTimeline::deserialize(const XmlElement &xml)
 
 XmlElement *ProjectTimeline::serializeAnnotationsDelta() const
 {
-    auto xml = new XmlElement(ProjectTimelineDeltas::annotationsAdded);
-
-    for (int i = 0; i < this->annotationsSequence->size(); ++i)
-    {
-        const MidiEvent *event = this->annotationsSequence->getUnchecked(i);
-        xml->addChildElement(event->serialize());
-    }
-
-    return xml;
+    return EventDeltas::serialize(*this->annotationsSequence, ProjectTimelineDeltas::annotationsAdded);
 }
 
 void ProjectTimeline::resetAnnotationsDelta(const XmlElement *state)
@@ -322,34 +315,56 @@ void ProjectTimeline::resetAnnotationsDelta(const XmlElement *state)
     jassert(state->getTagName() == ProjectTimelineDeltas::annotationsAdded);
     this->annotationsSequence->reset();
 
-    forEachXmlChildElementWithTagName(*state, e, Serialization::Core::annotation)
+    int numEvents = 0;
+    ScopedPointer<InputStream> in(EventDeltas::createEventsStream(*state, numEvents));
+
+    if (in != nullptr)
     {
-        this->annotationsSequence->silentImport(
-            AnnotationEvent(this->annotationsSequence).withParameters(*e));
+        for (int i = 0; i < numEvents && ! in->isExhausted(); ++i)
+        {
+            AnnotationEvent event(this->annotationsSequence);
+            event.readBinary(*in);
+            this->annotationsSequence->silentImport(event);
+        }
+    }
+    else
+    {
+        forEachXmlChildElementWithTagName(*state, e, Serialization::Core::annotation)
+        {
+            this->annotationsSequence->silentImport(
+                AnnotationEvent(this->annotationsSequence).withParameters(*e));
+        }
     }
 }
 
 XmlElement *ProjectTimeline::serializeTimeSignaturesDelta() const
 {
-    auto xml = new XmlElement(ProjectTimelineDeltas::timeSignaturesAdded);
-
-    for (int i = 0; i < this->timeSignaturesSequence->size(); ++i)
-    {
-        const MidiEvent *event = this->timeSignaturesSequence->getUnchecked(i);
-        xml->addChildElement(event->serialize());
-    }
-    
-    return xml;
+    return EventDeltas::serialize(*this->timeSignaturesSequence, ProjectTimelineDeltas::timeSignaturesAdded);
 }
 
 void ProjectTimeline::resetTimeSignaturesDelta(const XmlElement *state)
 {
     jassert(state->getTagName() == ProjectTimelineDeltas::timeSignaturesAdded);
     this->timeSignaturesSequence->reset();
-    
-    forEachXmlChildElementWithTagName(*state, e, Serialization::Core::timeSignature)
+
+    int numEvents = 0;
+    ScopedPointer<InputStream> in(EventDeltas::createEventsStream(*state, numEvents));
+
+    if (in != nullptr)
     {
-        this->timeSignaturesSequence->silentImport(
-            TimeSignatureEvent(this->timeSignaturesSequence).withParameters(*e));
+        for (int i = 0; i < numEvents && ! in->isExhausted(); ++i)
+        {
+            TimeSignatureEvent event(this->timeSignaturesSequence);
+            event.readBinary(*in);
+            this->timeSignaturesSequence->silentImport(event);
+        }
+    }
+    else
+    {
+        forEachXmlChildElementWithTagName(*state, e, Serialization::Core::timeSignature)
+        {
+            this->timeSignaturesSequence->silentImport(
+                TimeSignatureEvent(this->timeSignaturesSequence).withParameters(*e));
+        }
     }
 }
@@ -38,10 +38,12 @@
 #include "MidiSequence.h"
 #include "PianoSequence.h"
 #include "AutomationSequence.h"
+#include "Pattern.h"
 #include "Icons.h"
 #include "ProjectInfo.h"
 #include "ProjectTimeline.h"
 #include "DataEncoder.h"
+#include "ChunkedProjectFile.h"
 
 #include "TrackedItem.h"
 #include "VersionControlTreeItem.h"
@@ -501,23 +503,30 @@ void ProjectTreeItem::collectTracks(Array<MidiTrack *> &resultArray, bool onlySe
 }
 
 Point<float> ProjectTreeItem::getProjectRangeInBeats() const
+{
+    Array<MidiTrack *> tracks;
+    this->collectTracks(tracks);
+    return ProjectTreeItem::getRangeInBeats(tracks);
+}
+
+Point<float> ProjectTreeItem::getRangeInBeats(const Array<MidiTrack *> &tracks)
 {
     float lastBeat = -FLT_MAX;
     float firstBeat = FLT_MAX;
     const float defaultNumBeats = DEFAULT_NUM_BARS * NUM_BEATS_IN_BAR;
 
-    Array<MidiTrack *> tracks;
-    this->collectTracks(tracks);
-
     for (auto track : tracks)
     {
-        const float layerFirstBeat = track->getSequence()->getFirstBeat();
-        const float layerLastBeat = track->getSequence()->getLastBeat();
+        if (track->getSequence()->size() == 0)
+        { continue; }
+
+        // clips are sorted, so the first and the last ones define the range
+        const Array<float> clipOffsets(Pattern::getPlaybackOffsets(track));
+        const float layerFirstBeat = track->getSequence()->getFirstBeat() + clipOffsets.getFirst();
+        const float layerLastBeat = track->getSequence()->getLastBeat() + clipOffsets.getLast();
         //Logger::writeToLog(">  " + String(layerFirstBeat) + " : " + String(layerLastBeat));
         firstBeat = jmin(firstBeat, layerFirstBeat);
         lastBeat = jmax(lastBeat, layerLastBeat);
-
-        // TODO also take into account patterns!!!!!!!
     }
     
     if (firstBeat == FLT_MAX)
@@ -586,7 +595,7 @@ void ProjectTreeItem::reset()
 }
 
 
-XmlElement *ProjectTreeItem::save() const
+XmlElement *ProjectTreeItem::save(EventChunkWriter *eventChunks) const
 {
     auto xml = new XmlElement(Serialization::Core::project);
     xml->setAttribute("name", this->name);
@@ -602,14 +611,14 @@ XmlElement *ProjectTreeItem::save() const
 
     xml->addChildElement(this->undoStack->serialize());
     
-    TreeItemChildrenSerializer::serializeChildren(*this, *xml);
+    TreeItemChildrenSerializer::serializeChildren(*this, *xml, eventChunks);
 
     this->savePageState();
 
     return xml;
 }
 
-void ProjectTreeItem::load(const XmlElement &xml)
+void ProjectTreeItem::load(const XmlElement &xml, const ChunkedProjectFile *eventChunks)
 {
     this->reset();
 
@@ -624,6 +633,11 @@ void ProjectTreeItem::load(const XmlElement &xml)
     // Proceed with basic properties and children
     TreeItem::deserialize(*root);
 
+    if (eventChunks != nullptr)
+    {
+        this->loadEventChunks(*eventChunks);
+    }
+
     // Legacy support: if no pattern set manager found, create one
     if (nullptr == this->findChildOfType<PatternEditorTreeItem>())
     {
@@ -654,6 +668,23 @@ void ProjectTreeItem::load(const XmlElement &xml)
     this->transport->seekToPosition(seek);
 }
 
+void ProjectTreeItem::loadEventChunks(const ChunkedProjectFile &eventChunks)
+{
+    Array<MidiTrack *> tracks;
+    this->collectTracks(tracks);
+
+    for (auto track : tracks)
+    {
+        size_t size = 0;
+        const void *data = eventChunks.getChunkData(track->getTrackId().toString(), size);
+
+        if (data != nullptr)
+        {
+            track->getSequence()->loadBinaryChunk(data, size);
+        }
+    }
+}
+
 void ProjectTreeItem::importMidi(File &file)
 {
     MidiFile tempFile;
@@ -841,8 +872,20 @@ void ProjectTreeItem::broadcastChangeViewBeatRange(float firstBeat, float lastBe
 
 bool ProjectTreeItem::onDocumentLoad(File &file)
 {
-    if (file.existsAsFile())
+    if (ChunkedProjectFile::isChunkedFile(file))
+    {
+        const ChunkedProjectFile chunkedFile(file);
+        ScopedPointer<XmlElement> xml(chunkedFile.createProjectXml());
+
+        if (xml)
+        {
+            this->load(*xml, &chunkedFile);
+            return true;
+        }
+    }
+    else if (file.existsAsFile())
     {
+        // the older projects are all xml
         ScopedPointer<XmlElement> xml(DataEncoder::loadObfuscated(file));
 
         if (xml)
@@ -869,8 +912,11 @@ void ProjectTreeItem::onDocumentDidLoad(File &file)
 
 bool ProjectTreeItem::onDocumentSave(File &file)
 {
-    ScopedPointer<XmlElement> xml(this->save());
-    return DataEncoder::saveObfuscated(file, xml);
+    // the tracks put their events into chunks instead of the xml,
+    // and the clean ones give away their cached chunks
+    EventChunkWriter eventChunks;
+    ScopedPointer<XmlElement> xml(this->save(&eventChunks));
+    return ChunkedProjectFile::save(file, *xml, eventChunks);
 }
 
 void ProjectTreeItem::onDocumentImport(File &file)
@@ -901,8 +947,19 @@ void ProjectTreeItem::exportMidi(File &file) const
     
     for (auto track : tracks)
     {
-        // TODO patterns!
-        tempFile.addTrack(track->getSequence()->exportMidi());
+        const MidiSequence::ExportedMidi::Ptr midi(track->getSequence()->exportMidi());
+        const Array<float> clipOffsets(Pattern::getPlaybackOffsets(track));
+
+        // a file has no notion of clips, so they are written out in full
+        MidiMessageSequence arrangement;
+
+        for (const float offset : clipOffsets)
+        {
+            midi->addTo(arrangement, offset * Transport::millisecondsPerBeat);
+        }
+
+        arrangement.updateMatchedPairs();
+        tempFile.addTrack(arrangement);
     }
     
     ScopedPointer<OutputStream> out(new FileOutputStream(file));
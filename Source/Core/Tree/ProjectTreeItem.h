@@ -38,6 +38,8 @@ class ToolsSidebar;
 class UndoStack;
 class RecentFilesList;
 class Pattern;
+class ChunkedProjectFile;
+class EventChunkWriter;
 
 #include "TreeItem.h"
 #include "DocumentOwner.h"
@@ -148,6 +150,9 @@ public:
     Array<MidiTrack *> getSelectedTracks() const;
     Point<float> getProjectRangeInBeats() const;
 
+    // Also used by the batch renderer, which has no project tree
+    static Point<float> getRangeInBeats(const Array<MidiTrack *> &tracks);
+
     //===------------------------------------------------------------------===//
     // Serializable
     //===------------------------------------------------------------------===//
@@ -242,8 +247,9 @@ private:
 private:
 
     void initialize();
-    XmlElement *save() const;
-    void load(const XmlElement &xml);
+    XmlElement *save(EventChunkWriter *eventChunks = nullptr) const;
+    void load(const XmlElement &xml, const ChunkedProjectFile *eventChunks = nullptr);
+    void loadEventChunks(const ChunkedProjectFile &eventChunks);
 
 private:
 
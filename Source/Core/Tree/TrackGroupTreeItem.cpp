@@ -242,6 +242,16 @@ void TrackGroupTreeItem::safeRename(const String &newName)
 }
 
 
+//===----------------------------------------------------------------------===//
+// Serializable
+//===----------------------------------------------------------------------===//
+
+XmlElement *TrackGroupTreeItem::serializeWithEventChunks(EventChunkWriter &eventChunks) const
+{
+    return this->serializeTreeItem(&eventChunks);
+}
+
+
 //===----------------------------------------------------------------------===//
 // Menu
 //===----------------------------------------------------------------------===//
@@ -38,6 +38,12 @@ public:
     void showPage() override;
     void safeRename(const String &newName) override;
 
+    //===------------------------------------------------------------------===//
+    // Serializable
+    //===------------------------------------------------------------------===//
+
+    XmlElement *serializeWithEventChunks(EventChunkWriter &eventChunks) const override;
+
     //===------------------------------------------------------------------===//
     // Dragging
     //===------------------------------------------------------------------===//
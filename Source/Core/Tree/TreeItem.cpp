@@ -332,11 +332,22 @@ void TreeItem::reset()
 }
 
 XmlElement *TreeItem::serialize() const
+{
+    return this->serializeTreeItem(nullptr);
+}
+
+XmlElement *TreeItem::serializeWithEventChunks(EventChunkWriter &eventChunks) const
+{
+    // only the tracks and their groups make use of the chunks
+    return this->serialize();
+}
+
+XmlElement *TreeItem::serializeTreeItem(EventChunkWriter *eventChunks) const
 {
     auto xml = new XmlElement(Serialization::Core::treeItem);
     xml->setAttribute(Serialization::Core::treeItemType, this->type);
     xml->setAttribute(Serialization::Core::treeItemName, this->name);
-    TreeItemChildrenSerializer::serializeChildren(*this, *xml);
+    TreeItemChildrenSerializer::serializeChildren(*this, *xml, eventChunks);
     return xml;
 }
 
@@ -31,6 +31,8 @@
 #   define TREE_FONT_SIZE (20)
 #endif
 
+class EventChunkWriter;
+
 class TreeItem :
     public Serializable,
     public TreeViewItem,
@@ -230,8 +232,14 @@ public:
     XmlElement *serialize() const override;
     void deserialize(const XmlElement &xml) override;
 
+    // Same as serialize(), except that the tracks put their events
+    // into the chunk writer, leaving empty sequence nodes in xml
+    virtual XmlElement *serializeWithEventChunks(EventChunkWriter &eventChunks) const;
+
 protected:
 
+    XmlElement *serializeTreeItem(EventChunkWriter *eventChunks) const;
+
     void setVisible(bool shouldBeVisible) noexcept;
 
     template<typename T>
@@ -29,14 +29,17 @@
 #include "PatternEditorTreeItem.h"
 #include "SettingsTreeItem.h"
 
-void TreeItemChildrenSerializer::serializeChildren(const TreeItem &parentItem, XmlElement &parentXml)
+void TreeItemChildrenSerializer::serializeChildren(const TreeItem &parentItem, XmlElement &parentXml,
+    EventChunkWriter *eventChunks)
 {
     for (int i = 0; i < parentItem.getNumSubItems(); ++i)
     {
         if (TreeViewItem *sub = parentItem.getSubItem(i))
         {
             TreeItem *treeItem = static_cast<TreeItem *>(sub);
-            parentXml.addChildElement(treeItem->serialize());
+            parentXml.addChildElement((eventChunks != nullptr) ?
+                                      treeItem->serializeWithEventChunks(*eventChunks) :
+                                      treeItem->serialize());
         }
     }
 }
@@ -18,12 +18,14 @@
 #pragma once
 
 class TreeItem;
+class EventChunkWriter;
 
 class TreeItemChildrenSerializer
 {
 public:
 
-    static void serializeChildren(const TreeItem &parentItem, XmlElement &parentXml);
+    static void serializeChildren(const TreeItem &parentItem, XmlElement &parentXml,
+                                  EventChunkWriter *eventChunks = nullptr);
 
     static void deserializeChildren(TreeItem &parentItem, const XmlElement &parentXml);
 
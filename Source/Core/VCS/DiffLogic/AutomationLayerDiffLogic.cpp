@@ -20,6 +20,7 @@
 #include "AutomationTrackTreeItem.h"
 #include "AutoLayerDeltas.h"
 #include "PatternDiffLogic.h"
+#include "EventDeltas.h"
 #include "AutomationEvent.h"
 #include "AutomationSequence.h"
 #include "SerializationKeys.h"
@@ -365,23 +366,18 @@ XmlElement *mergeEventsAdded(const XmlElement *state, const XmlElement *changes)
     result.addArray(stateNotes);
 
     // на всякий пожарный, ищем, нет ли в состоянии нот с теми же id, где нет - добавляем
-    for (int i = 0; i < changesNotes.size(); ++i)
-    {
-        bool foundNoteInState = false;
-        const AutomationEvent *changesNote = static_cast<AutomationEvent *>(changesNotes.getUnchecked(i));
+    HashMap<MidiEvent::Id, int> stateIDs;
 
-        for (int j = 0; j < stateNotes.size(); ++j)
-        {
-            const AutomationEvent *stateNote = static_cast<AutomationEvent *>(stateNotes.getUnchecked(j));
+    for (int j = 0; j < stateNotes.size(); ++j)
+    {
+        stateIDs.set(stateNotes.getUnchecked(j)->getId(), j);
+    }
 
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInState = true;
-                break;
-            }
-        }
+    for (int i = 0; i < changesNotes.size(); ++i)
+    {
+        const MidiEvent *changesNote = changesNotes.getUnchecked(i);
 
-        if (! foundNoteInState)
+        if (! stateIDs.contains(changesNote->getId()))
         {
             result.add(changesNote);
         }
@@ -399,23 +395,18 @@ XmlElement *mergeEventsRemoved(const XmlElement *state, const XmlElement *change
     Array<const MidiEvent *> result;
 
     // добавляем все ноты из состояния, которых нет в изменениях
-    for (int i = 0; i < stateNotes.size(); ++i)
-    {
-        bool foundNoteInChanges = false;
-        const AutomationEvent *stateNote = static_cast<AutomationEvent *>(stateNotes.getUnchecked(i));
+    HashMap<MidiEvent::Id, int> changesIDs;
 
-        for (int j = 0; j < changesNotes.size(); ++j)
-        {
-            const AutomationEvent *changesNote = static_cast<AutomationEvent *>(changesNotes.getUnchecked(j));
+    for (int j = 0; j < changesNotes.size(); ++j)
+    {
+        changesIDs.set(changesNotes.getUnchecked(j)->getId(), j);
+    }
 
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInChanges = true;
-                break;
-            }
-        }
+    for (int i = 0; i < stateNotes.size(); ++i)
+    {
+        const MidiEvent *stateNote = stateNotes.getUnchecked(i);
 
-        if (! foundNoteInChanges)
+        if (! changesIDs.contains(stateNote->getId()))
         {
             result.add(stateNote);
         }
@@ -434,26 +425,20 @@ XmlElement *mergeEventsChanged(const XmlElement *state, const XmlElement *change
     result.addArray(stateNotes);
 
     // снова ищем по id и заменяем
-    for (int i = 0; i < stateNotes.size(); ++i)
+    HashMap<MidiEvent::Id, const MidiEvent *> changesIDs;
+
+    for (int j = 0; j < changesNotes.size(); ++j)
     {
-        bool foundNoteInChanges = false;
-        const AutomationEvent *stateNote = static_cast<AutomationEvent *>(stateNotes.getUnchecked(i));
+        const MidiEvent *changesNote = changesNotes.getUnchecked(j);
+        changesIDs.set(changesNote->getId(), changesNote);
+    }
 
-        for (int j = 0; j < changesNotes.size(); ++j)
+    for (int i = 0; i < stateNotes.size(); ++i)
+    {
+        if (const MidiEvent *changesNote = changesIDs[stateNotes.getUnchecked(i)->getId()])
         {
-            const AutomationEvent *changesNote = static_cast<AutomationEvent *>(changesNotes.getUnchecked(j));
-
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInChanges = true;
-                result.removeAllInstancesOf(stateNote);
-                result.addIfNotAlreadyThere(changesNote);
-
-                break;
-            }
+            result.set(i, changesNote);
         }
-
-        //jassert(foundNoteInChanges);
     }
 
     return serializeLayer(result, AutoLayerDeltas::eventsAdded);
@@ -521,62 +506,54 @@ Array<NewSerializedDelta> createEventsDiffs(const XmlElement *state, const XmlEl
     Array<const MidiEvent *> removedEvents;
     Array<const MidiEvent *> changedEvents;
 
-    // собственно, само сравнение
+    // собственно, само сравнение, по хэш-таблицам id с обеих сторон
+    HashMap<MidiEvent::Id, const MidiEvent *> stateIDs;
+    HashMap<MidiEvent::Id, const MidiEvent *> changesIDs;
+
+    for (auto stateEvent : stateEvents)
+    {
+        stateIDs.set(stateEvent->getId(), stateEvent);
+    }
+
+    for (auto changesEvent : changesEvents)
+    {
+        changesIDs.set(changesEvent->getId(), changesEvent);
+    }
+
     for (int i = 0; i < stateEvents.size(); ++i)
     {
-        bool foundNoteInChanges = false;
         const AutomationEvent *stateEvent = static_cast<AutomationEvent *>(stateEvents.getUnchecked(i));
 
-        for (int j = 0; j < changesEvents.size(); ++j)
+        // нота из состояния - существует в изменениях. добавляем запись changed, если нужно.
+        if (const MidiEvent *foundEvent = changesIDs[stateEvent->getId()])
         {
-            const AutomationEvent *changesEvent = static_cast<AutomationEvent *>(changesEvents.getUnchecked(j));
-
-            // нота из состояния - существует в изменениях. добавляем запись changed, если нужно.
-            if (stateEvent->getId() == changesEvent->getId())
-            {
-                foundNoteInChanges = true;
-
-                const bool eventHasChanged = (stateEvent->getBeat() != changesEvent->getBeat() ||
-                                              stateEvent->getCurvature() != changesEvent->getCurvature() ||
-                                              stateEvent->getControllerValue() != changesEvent->getControllerValue());
+            const AutomationEvent *changesEvent = static_cast<const AutomationEvent *>(foundEvent);
 
-                if (eventHasChanged)
-                {
-                    changedEvents.add(changesEvent);
-                }
+            const bool eventHasChanged = (stateEvent->getBeat() != changesEvent->getBeat() ||
+                                          stateEvent->getCurvature() != changesEvent->getCurvature() ||
+                                          stateEvent->getControllerValue() != changesEvent->getControllerValue());
 
-                break;
+            if (eventHasChanged)
+            {
+                changedEvents.add(changesEvent);
             }
         }
-
-        // нота из состояния - в изменениях не найдена. добавляем запись removed.
-        if (! foundNoteInChanges)
+        else
         {
+            // нота из состояния - в изменениях не найдена. добавляем запись removed.
             removedEvents.add(stateEvent);
         }
     }
 
-    // теперь ищем в изменениях ноты, которые отсутствуют в состоянии
+    // теперь ищем в изменениях ноты, которые отсутствуют в состоянии,
+    // и пишем их в список добавленных
     for (int i = 0; i < changesEvents.size(); ++i)
     {
-        bool foundNoteInState = false;
-        const AutomationEvent *changesNote = static_cast<AutomationEvent *>(changesEvents.getUnchecked(i));
-
-        for (int j = 0; j < stateEvents.size(); ++j)
-        {
-            const AutomationEvent *stateNote = static_cast<AutomationEvent *>(stateEvents.getUnchecked(j));
-
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInState = true;
-                break;
-            }
-        }
+        const MidiEvent *changesEvent = changesEvents.getUnchecked(i);
 
-        // и пишем ее в список добавленных
-        if (! foundNoteInState)
+        if (! stateIDs.contains(changesEvent->getId()))
         {
-            addedEvents.add(changesNote);
+            addedEvents.add(changesEvent);
         }
     }
 
@@ -616,22 +593,37 @@ void deserializeChanges(const XmlElement *state,
 {
     if (state != nullptr)
     {
-        forEachXmlChildElementWithTagName(*state, e, Serialization::Core::event)
+        // binary events are decoded right into the array,
+        // xml ones only come from the older projects
+        if (! EventDeltas::deserialize<AutomationEvent>(*state, stateNotes))
         {
-            auto event = new AutomationEvent();
-            event->deserialize(*e);
-            stateNotes.addSorted(*event, event);
+            forEachXmlChildElementWithTagName(*state, e, Serialization::Core::event)
+            {
+                auto event = new AutomationEvent();
+                event->deserialize(*e);
+                stateNotes.add(event);
+            }
         }
+
+        // one sort instead of a sorted insertion for each event
+        AutomationEvent comparator;
+        stateNotes.sort(comparator);
     }
 
     if (changes != nullptr)
     {
-        forEachXmlChildElementWithTagName(*changes, e, Serialization::Core::event)
+        if (! EventDeltas::deserialize<AutomationEvent>(*changes, changesNotes))
         {
-            auto event = new AutomationEvent();
-            event->deserialize(*e);
-            changesNotes.addSorted(*event, event);
+            forEachXmlChildElementWithTagName(*changes, e, Serialization::Core::event)
+            {
+                auto event = new AutomationEvent();
+                event->deserialize(*e);
+                changesNotes.add(event);
+            }
         }
+
+        AutomationEvent comparator;
+        changesNotes.sort(comparator);
     }
 }
 
@@ -646,15 +638,7 @@ NewSerializedDelta serializeChanges(Array<const MidiEvent *> changes,
 
 XmlElement *serializeLayer(Array<const MidiEvent *> changes, const String &tag)
 {
-    auto xml = new XmlElement(tag);
-
-    for (int i = 0; i < changes.size(); ++i)
-    {
-        const MidiEvent *event = changes.getUnchecked(i);
-        xml->addChildElement(event->serialize());
-    }
-
-    return xml;
+    return EventDeltas::serialize(changes, tag);
 }
 
 bool checkIfDeltaIsEventsType(const Delta *delta)
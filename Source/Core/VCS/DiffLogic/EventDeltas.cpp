@@ -0,0 +1,84 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "Common.h"
+#include "EventDeltas.h"
+#include "MidiEvent.h"
+#include "MidiSequence.h"
+#include "SerializationKeys.h"
+
+static XmlElement *createDelta(const String &deltaType, const MemoryOutputStream &events)
+{
+    auto xml = new XmlElement(deltaType);
+    xml->setAttribute(Serialization::VCS::deltaEvents, events.getMemoryBlock().toBase64Encoding());
+    return xml;
+}
+
+XmlElement *EventDeltas::serialize(const Array<const MidiEvent *> &events, const String &deltaType)
+{
+    MemoryOutputStream out;
+    out.writeCompressedInt(events.size());
+
+    for (auto event : events)
+    {
+        event->writeBinary(out);
+    }
+
+    return createDelta(deltaType, out);
+}
+
+XmlElement *EventDeltas::serialize(const MidiSequence &sequence, const String &deltaType)
+{
+    MemoryOutputStream out;
+    out.writeCompressedInt(sequence.size());
+
+    for (int i = 0; i < sequence.size(); ++i)
+    {
+        sequence.getUnchecked(i)->writeBinary(out);
+    }
+
+    return createDelta(deltaType, out);
+}
+
+InputStream *EventDeltas::createEventsStream(const XmlElement &delta, int &outNumEvents)
+{
+    MemoryBlock data;
+
+    if (! getBinaryData(delta, data))
+    { return nullptr; }
+
+    auto in = new MemoryInputStream(data, true);
+    outNumEvents = jmax(0, in->readCompressedInt());
+    return in;
+}
+
+bool EventDeltas::getBinaryData(const XmlElement &delta, MemoryBlock &outData)
+{
+    if (delta.getNumAttributes() != 1 ||
+        ! delta.hasAttribute(Serialization::VCS::deltaEvents))
+    { return false; }
+
+    return outData.fromBase64Encoding(delta.getStringAttribute(Serialization::VCS::deltaEvents));
+}
+
+XmlElement *EventDeltas::createFromBinaryData(const String &deltaType, const void *data, size_t size)
+{
+    auto xml = new XmlElement(deltaType);
+    xml->setAttribute(Serialization::VCS::deltaEvents, MemoryBlock(data, size).toBase64Encoding());
+    return xml;
+}
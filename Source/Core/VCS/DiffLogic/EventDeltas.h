@@ -0,0 +1,62 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+class MidiEvent;
+class MidiSequence;
+
+// Event deltas (notes, automation events, annotations and time signatures)
+// keep all their events in a single binary attribute, see MidiEvent::writeBinary(),
+// instead of an xml element per event; the pack stores them as raw binary.
+// Deltas from older projects still have xml events, so readers fall back to those.
+
+namespace EventDeltas
+{
+    XmlElement *serialize(const Array<const MidiEvent *> &events, const String &deltaType);
+    XmlElement *serialize(const MidiSequence &sequence, const String &deltaType);
+
+    // Returns a stream positioned at the first binary event,
+    // or nullptr if the delta has its events as xml
+    InputStream *createEventsStream(const XmlElement &delta, int &outNumEvents);
+
+    template<typename EventType, typename ArrayType>
+    bool deserialize(const XmlElement &delta, ArrayType &result)
+    {
+        int numEvents = 0;
+        ScopedPointer<InputStream> in(createEventsStream(delta, numEvents));
+
+        if (in == nullptr)
+        { return false; }
+
+        result.ensureStorageAllocated(result.size() + numEvents);
+
+        for (int i = 0; i < numEvents && ! in->isExhausted(); ++i)
+        {
+            auto event = new EventType();
+            event->readBinary(*in);
+            result.add(event);
+        }
+
+        return true;
+    }
+
+    // Raw data for the pack
+    bool getBinaryData(const XmlElement &delta, MemoryBlock &outData);
+    XmlElement *createFromBinaryData(const String &deltaType, const void *data, size_t size);
+} // namespace EventDeltas
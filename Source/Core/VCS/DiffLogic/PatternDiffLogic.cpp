@@ -161,9 +161,7 @@ XmlElement *PatternDiffLogic::mergeClipsChanged(const XmlElement *state,
 
         if (changesIDs.contains(stateClip.getId()))
         {
-            const Clip changesClip = changesIDs[stateClip.getId()];
-            result.removeAllInstancesOf(stateClip);
-            result.addIfNotAlreadyThere(changesClip);
+            result.set(i, changesIDs[stateClip.getId()]);
         }
     }
 
@@ -184,28 +182,33 @@ Array<VCS::NewSerializedDelta> PatternDiffLogic::createClipsDiffs(
     Array<Clip> removedClips;
     Array<Clip> changedClips;
 
+    HashMap<Clip::Id, int> stateIDs;
+    HashMap<Clip::Id, int> changesIDs;
+
     for (int i = 0; i < stateClips.size(); ++i)
     {
-        bool foundInChanges = false;
-        const Clip stateClip(stateClips.getUnchecked(i));
+        stateIDs.set(stateClips.getReference(i).getId(), i);
+    }
+
+    for (int j = 0; j < changesClips.size(); ++j)
+    {
+        changesIDs.set(changesClips.getReference(j).getId(), j);
+    }
+
+    for (int i = 0; i < stateClips.size(); ++i)
+    {
+        const Clip &stateClip = stateClips.getReference(i);
 
-        for (int j = 0; j < changesClips.size(); ++j)
+        if (changesIDs.contains(stateClip.getId()))
         {
-            const Clip changesClip(changesClips.getUnchecked(j));
+            const Clip &changesClip = changesClips.getReference(changesIDs[stateClip.getId()]);
 
-            if (stateClip.getId() == changesClip.getId())
+            if (stateClip.getStartBeat() != changesClip.getStartBeat())
             {
-                foundInChanges = true;
-                if (stateClip.getStartBeat() != changesClip.getStartBeat())
-                {
-                    changedClips.add(changesClip);
-                }
-
-                break;
+                changedClips.add(changesClip);
             }
         }
-
-        if (!foundInChanges)
+        else
         {
             removedClips.add(stateClip);
         }
@@ -213,20 +216,9 @@ Array<VCS::NewSerializedDelta> PatternDiffLogic::createClipsDiffs(
 
     for (int i = 0; i < changesClips.size(); ++i)
     {
-        bool foundInState = false;
-        const Clip changesClip(changesClips.getUnchecked(i));
+        const Clip &changesClip = changesClips.getReference(i);
 
-        for (int j = 0; j < stateClips.size(); ++j)
-        {
-            const Clip stateClip(stateClips.getUnchecked(j));
-            if (stateClip.getId() == changesClip.getId())
-            {
-                foundInState = true;
-                break;
-            }
-        }
-
-        if (!foundInState)
+        if (! stateIDs.contains(changesClip.getId()))
         {
             addedClips.add(changesClip);
         }
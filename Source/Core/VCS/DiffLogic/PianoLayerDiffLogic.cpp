@@ -21,6 +21,7 @@
 #include "PianoLayerDeltas.h"
 #include "MidiTrackDeltas.h"
 #include "PatternDiffLogic.h"
+#include "EventDeltas.h"
 #include "Note.h"
 #include "PianoSequence.h"
 #include "SerializationKeys.h"
@@ -432,9 +433,7 @@ XmlElement *mergeNotesChanged(const XmlElement *state, const XmlElement *changes
         const Note *stateNote(stateNotes.getUnchecked(i));
         if (changesIDs.contains(stateNote->getId()))
         {
-            const Note *changesNote = changesIDs[stateNote->getId()];
-            result.removeAllInstancesOf(stateNote);
-            result.addIfNotAlreadyThere(changesNote);
+            result.set(i, changesIDs[stateNote->getId()]);
         }
     }
 
@@ -501,62 +500,52 @@ Array<NewSerializedDelta> createEventsDiffs(const XmlElement *state, const XmlEl
     Array<const MidiEvent *> removedNotes;
     Array<const MidiEvent *> changedNotes;
 
-    // собственно, само сравнение
+    // собственно, само сравнение, по хэш-таблицам id с обеих сторон
+    HashMap<MidiEvent::Id, const Note *> stateIDs;
+    HashMap<MidiEvent::Id, const Note *> changesIDs;
+
+    for (auto stateNote : stateNotes)
+    {
+        stateIDs.set(stateNote->getId(), stateNote);
+    }
+
+    for (auto changesNote : changesNotes)
+    {
+        changesIDs.set(changesNote->getId(), changesNote);
+    }
+
     for (int i = 0; i < stateNotes.size(); ++i)
     {
-        bool foundNoteInChanges = false;
         const Note *stateNote(stateNotes.getUnchecked(i));
 
-        for (int j = 0; j < changesNotes.size(); ++j)
+        // нота из состояния - существует в изменениях. добавляем запись changed, если нужно.
+        if (const Note *changesNote = changesIDs[stateNote->getId()])
         {
-            const Note *changesNote(changesNotes.getUnchecked(j));
+            const bool noteHasChanged =
+                (stateNote->getKey() != changesNote->getKey() ||
+                stateNote->getBeat() != changesNote->getBeat() ||
+                stateNote->getLength() != changesNote->getLength() ||
+                stateNote->getVelocity() != changesNote->getVelocity());
 
-            // нота из состояния - существует в изменениях. добавляем запись changed, если нужно.
-            if (stateNote->getId() == changesNote->getId())
+            if (noteHasChanged)
             {
-                foundNoteInChanges = true;
-
-                const bool noteHasChanged =
-                    (stateNote->getKey() != changesNote->getKey() ||
-                    stateNote->getBeat() != changesNote->getBeat() ||
-                    stateNote->getLength() != changesNote->getLength() ||
-                    stateNote->getVelocity() != changesNote->getVelocity());
-
-                if (noteHasChanged)
-                {
-                    changedNotes.add(changesNote);
-                }
-
-                break;
+                changedNotes.add(changesNote);
             }
         }
-
-        // нота из состояния - в изменениях не найдена. добавляем запись removed.
-        if (! foundNoteInChanges)
+        else
         {
+            // нота из состояния - в изменениях не найдена. добавляем запись removed.
             removedNotes.add(stateNote);
         }
     }
 
-    // теперь ищем в изменениях ноты, которые отсутствуют в состоянии
+    // теперь ищем в изменениях ноты, которые отсутствуют в состоянии,
+    // и пишем их в список добавленных
     for (int i = 0; i < changesNotes.size(); ++i)
     {
-        bool foundNoteInState = false;
         const Note *changesNote(changesNotes.getUnchecked(i));
 
-        for (int j = 0; j < stateNotes.size(); ++j)
-        {
-            const Note *stateNote(stateNotes.getUnchecked(j));
-
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInState = true;
-                break;
-            }
-        }
-
-        // и пишем ее в список добавленных
-        if (! foundNoteInState)
+        if (! stateIDs.contains(changesNote->getId()))
         {
             addedNotes.add(changesNote);
         }
@@ -599,22 +588,37 @@ void deserializeLayerChanges(const XmlElement *state,
 {
     if (state != nullptr)
     {
-        forEachXmlChildElementWithTagName(*state, e, Serialization::Core::note)
+        // binary events are decoded right into the array,
+        // xml ones only come from the older projects
+        if (! EventDeltas::deserialize<Note>(*state, stateNotes))
         {
-            auto note = new Note();
-            note->deserialize(*e);
-            stateNotes.addSorted(*note, note);
+            forEachXmlChildElementWithTagName(*state, e, Serialization::Core::note)
+            {
+                auto note = new Note();
+                note->deserialize(*e);
+                stateNotes.add(note);
+            }
         }
+
+        // one sort instead of a sorted insertion for each note
+        Note comparator;
+        stateNotes.sort(comparator);
     }
 
     if (changes != nullptr)
     {
-        forEachXmlChildElementWithTagName(*changes, e, Serialization::Core::note)
+        if (! EventDeltas::deserialize<Note>(*changes, changesNotes))
         {
-            auto note = new Note();
-            note->deserialize(*e);
-            changesNotes.addSorted(*note, note);
+            forEachXmlChildElementWithTagName(*changes, e, Serialization::Core::note)
+            {
+                auto note = new Note();
+                note->deserialize(*e);
+                changesNotes.add(note);
+            }
         }
+
+        Note comparator;
+        changesNotes.sort(comparator);
     }
 }
 
@@ -629,15 +633,7 @@ NewSerializedDelta serializeLayerChanges(Array<const MidiEvent *> changes,
 
 XmlElement *serializeLayer(Array<const MidiEvent *> changes, const String &tag)
 {
-    auto xml = new XmlElement(tag);
-
-    for (int i = 0; i < changes.size(); ++i)
-    {
-        const MidiEvent *event = changes.getUnchecked(i);
-        xml->addChildElement(event->serialize());
-    }
-
-    return xml;
+    return EventDeltas::serialize(changes, tag);
 }
 
 bool checkIfDeltaIsNotesType(const Delta *delta)
@@ -23,6 +23,7 @@
 #include "AnnotationsSequence.h"
 #include "TimeSignaturesSequence.h"
 #include "SerializationKeys.h"
+#include "EventDeltas.h"
 
 using namespace VCS;
 
@@ -232,23 +233,18 @@ XmlElement *ProjectTimelineDiffLogic::mergeAnnotationsAdded(const XmlElement *st
     result.addArray(stateNotes);
 
     // на всякий пожарный, ищем, нет ли в состоянии нот с теми же id, где нет - добавляем
-    for (int i = 0; i < changesNotes.size(); ++i)
-    {
-        bool foundNoteInState = false;
-        const AnnotationEvent *changesNote = static_cast<AnnotationEvent *>(changesNotes.getUnchecked(i));
+    HashMap<MidiEvent::Id, int> stateIDs;
 
-        for (int j = 0; j < stateNotes.size(); ++j)
-        {
-            const AnnotationEvent *stateNote = static_cast<AnnotationEvent *>(stateNotes.getUnchecked(j));
+    for (int j = 0; j < stateNotes.size(); ++j)
+    {
+        stateIDs.set(stateNotes.getUnchecked(j)->getId(), j);
+    }
 
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInState = true;
-                break;
-            }
-        }
+    for (int i = 0; i < changesNotes.size(); ++i)
+    {
+        const MidiEvent *changesNote = changesNotes.getUnchecked(i);
 
-        if (! foundNoteInState)
+        if (! stateIDs.contains(changesNote->getId()))
         {
             result.add(changesNote);
         }
@@ -266,23 +262,18 @@ XmlElement *ProjectTimelineDiffLogic::mergeAnnotationsRemoved(const XmlElement *
     Array<const MidiEvent *> result;
 
     // добавляем все ноты из состояния, которых нет в изменениях
-    for (int i = 0; i < stateNotes.size(); ++i)
-    {
-        bool foundNoteInChanges = false;
-        const AnnotationEvent *stateNote = static_cast<AnnotationEvent *>(stateNotes.getUnchecked(i));
+    HashMap<MidiEvent::Id, int> changesIDs;
 
-        for (int j = 0; j < changesNotes.size(); ++j)
-        {
-            const AnnotationEvent *changesNote = static_cast<AnnotationEvent *>(changesNotes.getUnchecked(j));
+    for (int j = 0; j < changesNotes.size(); ++j)
+    {
+        changesIDs.set(changesNotes.getUnchecked(j)->getId(), j);
+    }
 
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInChanges = true;
-                break;
-            }
-        }
+    for (int i = 0; i < stateNotes.size(); ++i)
+    {
+        const MidiEvent *stateNote = stateNotes.getUnchecked(i);
 
-        if (! foundNoteInChanges)
+        if (! changesIDs.contains(stateNote->getId()))
         {
             result.add(stateNote);
         }
@@ -302,26 +293,20 @@ XmlElement *ProjectTimelineDiffLogic::mergeAnnotationsChanged(const XmlElement *
     result.addArray(stateNotes);
 
     // снова ищем по id и заменяем
-    for (int i = 0; i < stateNotes.size(); ++i)
+    HashMap<MidiEvent::Id, const MidiEvent *> changesIDs;
+
+    for (int j = 0; j < changesNotes.size(); ++j)
     {
-        bool foundNoteInChanges = false;
-        const AnnotationEvent *stateNote = static_cast<AnnotationEvent *>(stateNotes.getUnchecked(i));
+        const MidiEvent *changesNote = changesNotes.getUnchecked(j);
+        changesIDs.set(changesNote->getId(), changesNote);
+    }
 
-        for (int j = 0; j < changesNotes.size(); ++j)
+    for (int i = 0; i < stateNotes.size(); ++i)
+    {
+        if (const MidiEvent *changesNote = changesIDs[stateNotes.getUnchecked(i)->getId()])
         {
-            const AnnotationEvent *changesNote = static_cast<AnnotationEvent *>(changesNotes.getUnchecked(j));
-
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInChanges = true;
-                result.removeAllInstancesOf(stateNote);
-                result.addIfNotAlreadyThere(changesNote);
-
-                break;
-            }
+            result.set(i, changesNote);
         }
-
-        //jassert(foundNoteInChanges);
     }
 
     return this->serializeLayer(result, ProjectTimelineDeltas::annotationsAdded);
@@ -342,28 +327,23 @@ XmlElement *ProjectTimelineDiffLogic::mergeTimeSignaturesAdded(const XmlElement
     result.addArray(stateNotes);
     
     // на всякий пожарный, ищем, нет ли в состоянии нот с теми же id, где нет - добавляем
+    HashMap<MidiEvent::Id, int> stateIDs;
+
+    for (int j = 0; j < stateNotes.size(); ++j)
+    {
+        stateIDs.set(stateNotes.getUnchecked(j)->getId(), j);
+    }
+
     for (int i = 0; i < changesNotes.size(); ++i)
     {
-        bool foundNoteInState = false;
-        const TimeSignatureEvent *changesNote = static_cast<TimeSignatureEvent *>(changesNotes.getUnchecked(i));
-        
-        for (int j = 0; j < stateNotes.size(); ++j)
-        {
-            const TimeSignatureEvent *stateNote = static_cast<TimeSignatureEvent *>(stateNotes.getUnchecked(j));
-            
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInState = true;
-                break;
-            }
-        }
-        
-        if (! foundNoteInState)
+        const MidiEvent *changesNote = changesNotes.getUnchecked(i);
+
+        if (! stateIDs.contains(changesNote->getId()))
         {
             result.add(changesNote);
         }
     }
-    
+
     return this->serializeLayer(result, ProjectTimelineDeltas::timeSignaturesAdded);
 }
 
@@ -376,28 +356,23 @@ XmlElement *ProjectTimelineDiffLogic::mergeTimeSignaturesRemoved(const XmlElemen
     Array<const MidiEvent *> result;
     
     // добавляем все ноты из состояния, которых нет в изменениях
+    HashMap<MidiEvent::Id, int> changesIDs;
+
+    for (int j = 0; j < changesNotes.size(); ++j)
+    {
+        changesIDs.set(changesNotes.getUnchecked(j)->getId(), j);
+    }
+
     for (int i = 0; i < stateNotes.size(); ++i)
     {
-        bool foundNoteInChanges = false;
-        const TimeSignatureEvent *stateNote = static_cast<TimeSignatureEvent *>(stateNotes.getUnchecked(i));
-        
-        for (int j = 0; j < changesNotes.size(); ++j)
-        {
-            const TimeSignatureEvent *changesNote = static_cast<TimeSignatureEvent *>(changesNotes.getUnchecked(j));
-            
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInChanges = true;
-                break;
-            }
-        }
-        
-        if (! foundNoteInChanges)
+        const MidiEvent *stateNote = stateNotes.getUnchecked(i);
+
+        if (! changesIDs.contains(stateNote->getId()))
         {
             result.add(stateNote);
         }
     }
-    
+
     return this->serializeLayer(result, ProjectTimelineDeltas::timeSignaturesAdded);
 }
 
@@ -412,28 +387,22 @@ XmlElement *ProjectTimelineDiffLogic::mergeTimeSignaturesChanged(const XmlElemen
     result.addArray(stateNotes);
     
     // снова ищем по id и заменяем
+    HashMap<MidiEvent::Id, const MidiEvent *> changesIDs;
+
+    for (int j = 0; j < changesNotes.size(); ++j)
+    {
+        const MidiEvent *changesNote = changesNotes.getUnchecked(j);
+        changesIDs.set(changesNote->getId(), changesNote);
+    }
+
     for (int i = 0; i < stateNotes.size(); ++i)
     {
-        bool foundNoteInChanges = false;
-        const TimeSignatureEvent *stateNote = static_cast<TimeSignatureEvent *>(stateNotes.getUnchecked(i));
-        
-        for (int j = 0; j < changesNotes.size(); ++j)
+        if (const MidiEvent *changesNote = changesIDs[stateNotes.getUnchecked(i)->getId()])
         {
-            const TimeSignatureEvent *changesNote = static_cast<TimeSignatureEvent *>(changesNotes.getUnchecked(j));
-            
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInChanges = true;
-                result.removeAllInstancesOf(stateNote);
-                result.addIfNotAlreadyThere(changesNote);
-                
-                break;
-            }
+            result.set(i, changesNote);
         }
-        
-        //jassert(foundNoteInChanges);
     }
-    
+
     return this->serializeLayer(result, ProjectTimelineDeltas::timeSignaturesAdded);
 }
 
@@ -458,62 +427,54 @@ Array<NewSerializedDelta> ProjectTimelineDiffLogic::createAnnotationsDiffs(const
     Array<const MidiEvent *> removedEvents;
     Array<const MidiEvent *> changedEvents;
 
-    // собственно, само сравнение
+    // собственно, само сравнение, по хэш-таблицам id с обеих сторон
+    HashMap<MidiEvent::Id, const MidiEvent *> stateIDs;
+    HashMap<MidiEvent::Id, const MidiEvent *> changesIDs;
+
+    for (auto stateEvent : stateEvents)
+    {
+        stateIDs.set(stateEvent->getId(), stateEvent);
+    }
+
+    for (auto changesEvent : changesEvents)
+    {
+        changesIDs.set(changesEvent->getId(), changesEvent);
+    }
+
     for (int i = 0; i < stateEvents.size(); ++i)
     {
-        bool foundNoteInChanges = false;
         const AnnotationEvent *stateEvent = static_cast<AnnotationEvent *>(stateEvents.getUnchecked(i));
 
-        for (int j = 0; j < changesEvents.size(); ++j)
+        // нота из состояния - существует в изменениях. добавляем запись changed, если нужно.
+        if (const MidiEvent *foundEvent = changesIDs[stateEvent->getId()])
         {
-            const AnnotationEvent *changesEvent = static_cast<AnnotationEvent *>(changesEvents.getUnchecked(j));
+            const AnnotationEvent *changesEvent = static_cast<const AnnotationEvent *>(foundEvent);
 
-            // нота из состояния - существует в изменениях. добавляем запись changed, если нужно.
-            if (stateEvent->getId() == changesEvent->getId())
-            {
-                foundNoteInChanges = true;
+            const bool eventHasChanged = (stateEvent->getBeat() != changesEvent->getBeat() ||
+                                          stateEvent->getColour() != changesEvent->getColour() ||
+                                          stateEvent->getDescription() != changesEvent->getDescription());
 
-                const bool eventHasChanged = (stateEvent->getBeat() != changesEvent->getBeat() ||
-                                              stateEvent->getColour() != changesEvent->getColour() ||
-                                              stateEvent->getDescription() != changesEvent->getDescription());
-
-                if (eventHasChanged)
-                {
-                    changedEvents.add(changesEvent);
-                }
-
-                break;
+            if (eventHasChanged)
+            {
+                changedEvents.add(changesEvent);
             }
         }
-
-        // нота из состояния - в изменениях не найдена. добавляем запись removed.
-        if (! foundNoteInChanges)
+        else
         {
+            // нота из состояния - в изменениях не найдена. добавляем запись removed.
             removedEvents.add(stateEvent);
         }
     }
 
-    // теперь ищем в изменениях ноты, которые отсутствуют в состоянии
+    // теперь ищем в изменениях ноты, которые отсутствуют в состоянии,
+    // и пишем их в список добавленных
     for (int i = 0; i < changesEvents.size(); ++i)
     {
-        bool foundNoteInState = false;
-        const AnnotationEvent *changesNote = static_cast<AnnotationEvent *>(changesEvents.getUnchecked(i));
+        const MidiEvent *changesEvent = changesEvents.getUnchecked(i);
 
-        for (int j = 0; j < stateEvents.size(); ++j)
+        if (! stateIDs.contains(changesEvent->getId()))
         {
-            const AnnotationEvent *stateNote = static_cast<AnnotationEvent *>(stateEvents.getUnchecked(j));
-
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInState = true;
-                break;
-            }
-        }
-
-        // и пишем ее в список добавленных
-        if (! foundNoteInState)
-        {
-            addedEvents.add(changesNote);
+            addedEvents.add(changesEvent);
         }
     }
 
@@ -559,65 +520,57 @@ Array<NewSerializedDelta> ProjectTimelineDiffLogic::createTimeSignaturesDiffs(co
     Array<const MidiEvent *> removedEvents;
     Array<const MidiEvent *> changedEvents;
     
-    // собственно, само сравнение
+    // собственно, само сравнение, по хэш-таблицам id с обеих сторон
+    HashMap<MidiEvent::Id, const MidiEvent *> stateIDs;
+    HashMap<MidiEvent::Id, const MidiEvent *> changesIDs;
+
+    for (auto stateEvent : stateEvents)
+    {
+        stateIDs.set(stateEvent->getId(), stateEvent);
+    }
+
+    for (auto changesEvent : changesEvents)
+    {
+        changesIDs.set(changesEvent->getId(), changesEvent);
+    }
+
     for (int i = 0; i < stateEvents.size(); ++i)
     {
-        bool foundNoteInChanges = false;
         const TimeSignatureEvent *stateEvent = static_cast<TimeSignatureEvent *>(stateEvents.getUnchecked(i));
-        
-        for (int j = 0; j < changesEvents.size(); ++j)
+
+        // событие из состояния - существует в изменениях. добавляем запись changed, если нужно.
+        if (const MidiEvent *foundEvent = changesIDs[stateEvent->getId()])
         {
-            const TimeSignatureEvent *changesEvent = static_cast<TimeSignatureEvent *>(changesEvents.getUnchecked(j));
-            
-            // событие из состояния - существует в изменениях. добавляем запись changed, если нужно.
-            if (stateEvent->getId() == changesEvent->getId())
+            const TimeSignatureEvent *changesEvent = static_cast<const TimeSignatureEvent *>(foundEvent);
+
+            const bool eventHasChanged = (stateEvent->getBeat() != changesEvent->getBeat() ||
+                                          stateEvent->getNumerator() != changesEvent->getNumerator() ||
+                                          stateEvent->getDenominator() != changesEvent->getDenominator());
+
+            if (eventHasChanged)
             {
-                foundNoteInChanges = true;
-                
-                const bool eventHasChanged = (stateEvent->getBeat() != changesEvent->getBeat() ||
-                                              stateEvent->getNumerator() != changesEvent->getNumerator() ||
-                                              stateEvent->getDenominator() != changesEvent->getDenominator());
-                
-                if (eventHasChanged)
-                {
-                    changedEvents.add(changesEvent);
-                }
-                
-                break;
+                changedEvents.add(changesEvent);
             }
         }
-        
-        // событие из состояния - в изменениях не найдена. добавляем запись removed.
-        if (! foundNoteInChanges)
+        else
         {
+            // событие из состояния - в изменениях не найдена. добавляем запись removed.
             removedEvents.add(stateEvent);
         }
     }
-    
-    // теперь ищем в изменениях события, которые отсутствуют в состоянии
+
+    // теперь ищем в изменениях события, которые отсутствуют в состоянии,
+    // и пишем их в список добавленных
     for (int i = 0; i < changesEvents.size(); ++i)
     {
-        bool foundNoteInState = false;
-        const TimeSignatureEvent *changesEvent = static_cast<TimeSignatureEvent *>(changesEvents.getUnchecked(i));
-        
-        for (int j = 0; j < stateEvents.size(); ++j)
-        {
-            const TimeSignatureEvent *stateEvent = static_cast<TimeSignatureEvent *>(stateEvents.getUnchecked(j));
-            
-            if (stateEvent->getId() == changesEvent->getId())
-            {
-                foundNoteInState = true;
-                break;
-            }
-        }
-        
-        // и пишем ее в список добавленных
-        if (! foundNoteInState)
+        const MidiEvent *changesEvent = changesEvents.getUnchecked(i);
+
+        if (! stateIDs.contains(changesEvent->getId()))
         {
             addedEvents.add(changesEvent);
         }
     }
-    
+
     // сериализуем диффы, если таковые есть
     
     if (addedEvents.size() > 0)
@@ -652,12 +605,35 @@ Array<NewSerializedDelta> ProjectTimelineDiffLogic::createTimeSignaturesDiffs(co
 // Serialization
 //===----------------------------------------------------------------------===//
 
+// Binary events are decoded right into the array,
+// xml ones only come from the older projects
+static bool deserializeBinaryEvents(const XmlElement &delta, OwnedArray<MidiEvent> &result)
+{
+    const bool isTimeSignaturesDelta =
+        delta.hasTagName(ProjectTimelineDeltas::timeSignaturesAdded) ||
+        delta.hasTagName(ProjectTimelineDeltas::timeSignaturesRemoved) ||
+        delta.hasTagName(ProjectTimelineDeltas::timeSignaturesChanged);
+
+    const bool isDecoded = isTimeSignaturesDelta ?
+        EventDeltas::deserialize<TimeSignatureEvent>(delta, result) :
+        EventDeltas::deserialize<AnnotationEvent>(delta, result);
+
+    if (isDecoded)
+    {
+        // one sort instead of a sorted insertion for each event
+        AnnotationEvent comparator;
+        result.sort(comparator);
+    }
+
+    return isDecoded;
+}
+
 void VCS::ProjectTimelineDiffLogic::deserializeChanges(const XmlElement *state,
         const XmlElement *changes,
         OwnedArray<MidiEvent> &stateNotes,
         OwnedArray<MidiEvent> &changesNotes) const
 {
-    if (state != nullptr)
+    if (state != nullptr && ! deserializeBinaryEvents(*state, stateNotes))
     {
         forEachXmlChildElementWithTagName(*state, e, Serialization::Core::annotation)
         {
@@ -674,7 +650,7 @@ void VCS::ProjectTimelineDiffLogic::deserializeChanges(const XmlElement *state,
         }
     }
 
-    if (changes != nullptr)
+    if (changes != nullptr && ! deserializeBinaryEvents(*changes, changesNotes))
     {
         forEachXmlChildElementWithTagName(*changes, e, Serialization::Core::annotation)
         {
@@ -704,15 +680,7 @@ NewSerializedDelta ProjectTimelineDiffLogic::serializeChanges(Array<const MidiEv
 XmlElement *ProjectTimelineDiffLogic::serializeLayer(Array<const MidiEvent *> changes,
         const String &tag) const
 {
-    auto xml = new XmlElement(tag);
-
-    for (int i = 0; i < changes.size(); ++i)
-    {
-        const MidiEvent *event = changes.getUnchecked(i);
-        xml->addChildElement(event->serialize());
-    }
-
-    return xml;
+    return EventDeltas::serialize(changes, tag);
 }
 
 bool ProjectTimelineDiffLogic::checkIfDeltaIsAnnotationType(const Delta *delta) const
@@ -28,6 +28,10 @@
 
 using namespace VCS;
 
+// На длинной ветке снапшот делается через каждые столько ревизий,
+// а также на каждой развилке
+#define HEAD_SNAPSHOT_INTERVAL 16
+
 Head::Head(const Head &other) :
     Thread("Diff Thread"),
     targetVcsItemsSource(other.targetVcsItemsSource),
@@ -175,28 +179,37 @@ bool Head::moveTo(const Revision &revision)
 
     if (this->targetVcsItemsSource != nullptr)
     {
-        // здесь надо будет пройтись до корня и запомнить все ревизии
+        // здесь надо будет пройтись до корня или до ближайшего снапшота
+        // и запомнить все ревизии
         Array<Revision> treePath;
         Revision currentRevision(revision);
-
-        // сначала обнуляем состояние
-        {
-            ScopedWriteLock lock(this->stateLock);
-            this->state = new HeadState();
-        }
+        const HeadState *snapshot = nullptr;
 
         Logger::writeToLog("Head::moveTo " + currentRevision.getUuid());
 
         while (currentRevision.isValid())
         {
-            treePath.insert(0, currentRevision);
+            snapshot = this->snapshotsByRevision[currentRevision.getUuid()];
+
+            if (snapshot != nullptr)
+            {
+                break;
+            }
+
+            treePath.add(currentRevision);
             currentRevision = Revision(currentRevision.getParent());
         }
 
+        // сначала обнуляем состояние, или начинаем со снапшота
+        {
+            ScopedWriteLock lock(this->stateLock);
+            this->state = (snapshot != nullptr) ? new HeadState(snapshot) : new HeadState();
+        }
+
         // затем, идти по ним в обратном порядке - от корня
-        for (auto && i : treePath)
+        for (int i = treePath.size(); --i >= 0;)
         {
-            const Revision rev(i);
+            const Revision rev(treePath.getReference(i));
 
             Logger::writeToLog("Head::moveTo -> " + rev.getUuid());
 
@@ -227,6 +240,14 @@ bool Head::moveTo(const Revision &revision)
                     }
                 }
             }
+
+            const int numReplayed = treePath.size() - i;
+            const bool isBranchPoint = (rev.getNumChildren() > 1);
+
+            if (isBranchPoint || (numReplayed % HEAD_SNAPSHOT_INTERVAL) == 0)
+            {
+                this->takeSnapshotOf(rev);
+            }
         }
     }
 
@@ -235,6 +256,25 @@ bool Head::moveTo(const Revision &revision)
     return true;
 }
 
+void Head::invalidateSnapshots()
+{
+    this->snapshotsByRevision.clear();
+    this->snapshots.clear();
+}
+
+// Элементы состояния неизменяемы и разделяются по ссылкам,
+// так что снапшот - это просто копия массива указателей
+void Head::takeSnapshotOf(const Revision &revision)
+{
+    const String revisionId(revision.getUuid());
+
+    if (! this->snapshotsByRevision.contains(revisionId))
+    {
+        HeadState *snapshot = this->snapshots.add(new HeadState(this->state.get()));
+        this->snapshotsByRevision.set(revisionId, snapshot);
+    }
+}
+
 void Head::pointTo(const Revision &revision)
 {
     this->headingAt = revision;
@@ -566,6 +606,7 @@ void Head::deserialize(const XmlElement &xml)
 
 void Head::reset()
 {
+    this->invalidateSnapshots();
     this->state = new HeadState();
     this->setDiffOutdated(true);
 }
@@ -59,6 +59,9 @@ namespace VCS
         void mergeStateWith(Revision changes);
 
         bool moveTo(const Revision &revision); // перестраивает индекс-состояние
+
+        // сбрасывает снапшоты, когда меняются уже существующие ревизии
+        void invalidateSnapshots();
         
         void pointTo(const Revision &revision); // не перестраивает индекс
         
@@ -122,6 +125,14 @@ namespace VCS
 
         ScopedPointer<HeadState> state;
 
+        // Materialised states of some of the revisions passed by moveTo,
+        // so that the next moveTo only replays the revisions after
+        // the nearest snapshot, and not the whole history from the root
+        OwnedArray<HeadState> snapshots;
+        HashMap<String, HeadState *> snapshotsByRevision;
+
+        void takeSnapshotOf(const Revision &revision);
+
     private:
 
         WeakReference<TrackedItemsSource> targetVcsItemsSource; // ProjectTreeItem
@@ -21,11 +21,50 @@
 #include "FileUtils.h"
 #include "DataEncoder.h"
 #include "SerializationKeys.h"
+#include "EventDeltas.h"
 
 using namespace VCS;
 
 #define VCS_PACK_DEBUGGING 0
 
+// Event deltas are stored as raw binary data, which starts with a zero byte,
+// and all other deltas are stored as xml text
+static void writeDeltaData(const XmlElement &data, MemoryBlock &target)
+{
+    MemoryOutputStream ms(target, false);
+    MemoryBlock events;
+
+    if (EventDeltas::getBinaryData(data, events))
+    {
+        ms.writeByte(0);
+        ms.writeString(data.getTagName());
+        ms.write(events.getData(), events.getSize());
+    }
+    else
+    {
+        data.writeToStream(ms, "", true, false);
+    }
+
+    ms.flush();
+}
+
+static XmlElement *createDeltaData(const MemoryBlock &data)
+{
+    if (data.getSize() > 0 && data[0] == 0)
+    {
+        MemoryInputStream in(data, false);
+        in.readByte();
+        const String deltaType(in.readString());
+        const size_t eventsOffset = size_t(in.getPosition());
+
+        return EventDeltas::createFromBinaryData(deltaType,
+            static_cast<const char *>(data.getData()) + eventsOffset,
+            data.getSize() - eventsOffset);
+    }
+
+    return XmlDocument::parse(data.toString());
+}
+
 //
 // пак - это такая штука, где хранятся все тяжеловесные данные,
 // которые можно достать по требованию, по id revisionItem + его дельты
@@ -66,23 +105,11 @@ bool Pack::containsDeltaDataFor(const Uuid &itemId,
 {
     if (this->packStream != nullptr)
     {
-        // данные могут быть на диске
-        for (auto header : this->headers)
-        {
-            if (header->itemId == itemId && header->deltaId == deltaId)
-            {
-                return true;
-            }
-        }
-        
-        // а могут быть и в памяти
-        for (auto block : this->unsavedData)
-        {
-            if (block->itemId == itemId && block->deltaId == deltaId)
-            {
-                return true;
-            }
-        }
+        const PackDataKey key = { itemId, deltaId };
+
+        // данные могут быть на диске, а могут быть и в памяти
+        return this->headersIndex.contains(key) ||
+               this->unsavedDataIndex.contains(key);
     }
     
     return false;
@@ -95,22 +122,18 @@ XmlElement *Pack::createDeltaDataFor(const Uuid &itemId,
     
     if (this->packStream != nullptr)
     {
+        const PackDataKey key = { itemId, deltaId };
+
         // данные могут быть на диске
-        for (auto header : this->headers)
+        if (PackDataHeader *header = this->headersIndex[key])
         {
-            if (header->itemId == itemId && header->deltaId == deltaId)
-            {
-                return this->createXmlData(header);
-            }
+            return this->createXmlData(header);
         }
 
         // а могут быть и в памяти
-        for (auto block : this->unsavedData)
+        if (PackDataBlock *block = this->unsavedDataIndex[key])
         {
-            if (block->itemId == itemId && block->deltaId == deltaId)
-            {
-                return XmlDocument::parse(block->data.toString());
-            }
+            return createDeltaData(block->data);
         }
     }
 
@@ -129,11 +152,10 @@ void Pack::setDeltaDataFor(const Uuid &itemId,
     block->deltaId = deltaId;
 
     // несохраненные данные в памяти незачем обфусцировать
-    MemoryOutputStream ms(block->data, false);
-    data.writeToStream(ms, "", true, false);
-    ms.flush();
+    writeDeltaData(data, block->data);
 
     this->unsavedData.add(block);
+    this->indexUnsavedBlock(block);
 }
 
 
@@ -166,7 +188,7 @@ XmlElement *Pack::serialize() const
     // и все новые данные
     for (auto block : this->unsavedData)
     {
-        XmlElement *deltaData = XmlDocument::parse(block->data.toString());
+        XmlElement *deltaData = createDeltaData(block->data);
 
         auto packItem = new XmlElement(Serialization::VCS::packItem);
         packItem->setAttribute(Serialization::VCS::packItemRevId, block->itemId.toString());
@@ -197,16 +219,13 @@ void Pack::deserialize(const XmlElement &xml)
         block->itemId = e->getStringAttribute(Serialization::VCS::packItemRevId);
         block->deltaId = e->getStringAttribute(Serialization::VCS::packItemDeltaId);
 
-        MemoryOutputStream ms(block->data, false);
-
         if (XmlElement *firstChild = e->getFirstChildElement())
         {
-            firstChild->writeToStream(ms, "", true, false);
+            writeDeltaData(*firstChild, block->data);
         }
 
-        ms.flush();
-
         this->unsavedData.add(block);
+        this->indexUnsavedBlock(block);
     }
 
     // и сливаем на диск
@@ -217,6 +236,8 @@ void Pack::reset()
 {
     ScopedLock lock(this->packStreamLock);
 
+    this->headersIndex.clear();
+    this->unsavedDataIndex.clear();
     this->headers.clear();
     this->unsavedData.clear();
     this->packStream = nullptr;
@@ -233,63 +254,89 @@ void Pack::flush()
 {
     ScopedLock lock(this->packStreamLock);
 
-    TemporaryFile tempFile(*this->packFile);
-    ScopedPointer<FileOutputStream> tempOutputStream(tempFile.getFile().createOutputStream());
-
-    jassert(tempOutputStream->openedOk());
+    if (this->packWriteLocker == nullptr)
+    {
+        this->packStream = nullptr;
+        this->packFile->deleteFile();
+        this->packWriteLocker = this->packFile->createOutputStream();
+        jassert(this->packWriteLocker->openedOk());
 
-    this->packWriteLocker = nullptr;
+        this->packStream = this->packFile->createInputStream();
+        jassert(this->packStream->openedOk());
+    }
 
-    // если нужно - скопируем существующий файл,
-    // и сразу закроем входной поток
-    if (this->packStream != nullptr)
+    if (this->unsavedData.size() == 0)
     {
-        this->packStream->setPosition(0);
-        tempOutputStream->writeFromInputStream(*this->packStream, -1);
-        this->packStream = nullptr;
+        return;
     }
 
-    // добавляем unsavedData
-    // достаточно обфусцировать их, дописать в конец файла
-    // и добавить в свой список PackDataHeader'ы с получившимися смещениями
+    // пак только растет, так что новые данные дописываются в конец файла,
+    // а хэдеры добавляются, только когда все данные записаны
+    const int64 committedSize = this->packWriteLocker->getPosition();
+    OwnedArray<PackDataHeader> newHeaders;
+
     for (auto block : this->unsavedData)
     {
         
 #if VCS_PACK_DEBUGGING
-        const String &obfuscated = block->data.toString();
+        const MemoryBlock &obfuscated = block->data;
 #else
-        const String &obfuscated = DataEncoder::obfuscateString(block->data.toString());
+        const MemoryBlock &obfuscated = DataEncoder::obfuscateData(block->data);
 #endif
 
-        const int64 position = tempOutputStream->getPosition();
-        const ssize_t numBytes = obfuscated.getNumBytesAsUTF8();
+        const int64 position = this->packWriteLocker->getPosition();
+        const ssize_t numBytes = obfuscated.getSize();
 
-        tempOutputStream->write(obfuscated.toRawUTF8(), numBytes);
+        this->packWriteLocker->write(obfuscated.getData(), numBytes);
 
-        auto newHeader = new PackDataHeader();
+        auto newHeader = newHeaders.add(new PackDataHeader());
         newHeader->itemId = block->itemId;
         newHeader->deltaId = block->deltaId;
         newHeader->startPosition = position;
         newHeader->numBytes = numBytes;
+    }
+
+    this->packWriteLocker->flush();
+
+    if (this->packWriteLocker->getStatus().failed())
+    {
+        // откатываемся к последнему целому состоянию, данные остаются в памяти
+        this->packWriteLocker->setPosition(committedSize);
+        this->packWriteLocker->truncate();
+        jassertfalse;
+        return;
+    }
 
-        this->headers.add(newHeader);
+    for (auto header : newHeaders)
+    {
+        this->indexHeader(header);
     }
 
+    this->headers.addArray(newHeaders);
+    newHeaders.clear(false);
+
+    this->unsavedDataIndex.clear();
     this->unsavedData.clear();
+}
 
-    tempOutputStream = nullptr;
+// The first added data wins, as it did with the linear search
+void Pack::indexHeader(PackDataHeader *header)
+{
+    const PackDataKey key = { header->itemId, header->deltaId };
 
-    if (tempFile.overwriteTargetFileWithTemporary())
+    if (! this->headersIndex.contains(key))
     {
-        this->packStream = this->packFile->createInputStream();
-        jassert(this->packStream->openedOk());
-
-        this->packWriteLocker = this->packFile->createOutputStream();
-        jassert(this->packWriteLocker->openedOk());
+        this->headersIndex.set(key, header);
     }
-    else
+}
+
+void Pack::indexUnsavedBlock(PackDataBlock *block)
+{
+    const PackDataKey key = { block->itemId, block->deltaId };
+
+    if (! this->unsavedDataIndex.contains(key))
     {
-        jassertfalse;
+        this->unsavedDataIndex.set(key, block);
     }
 }
 
@@ -301,10 +348,8 @@ XmlElement *Pack::createXmlData(const PackDataHeader *header) const
     this->packStream->readIntoMemoryBlock(mb, header->numBytes);
 
 #if VCS_PACK_DEBUGGING
-    const String &xmlData = mb.toString();
+    return createDeltaData(mb);
 #else
-    const String &xmlData = DataEncoder::deobfuscateString(mb.toString());
+    return createDeltaData(DataEncoder::deobfuscateData(mb));
 #endif
-
-    return XmlDocument::parse(xmlData);
 }
@@ -36,6 +36,32 @@ namespace VCS
         MemoryBlock data;
     };
 
+    struct PackDataKey
+    {
+        Uuid itemId;
+        Uuid deltaId;
+
+        friend inline bool operator==(const PackDataKey &lhs, const PackDataKey &rhs)
+        {
+            return (lhs.itemId == rhs.itemId && lhs.deltaId == rhs.deltaId);
+        }
+    };
+
+    class PackDataKeyHashFunction
+    {
+    public:
+
+        static int generateHash(const PackDataKey &key, const int upperLimit) noexcept
+        {
+            const uint8 *item = key.itemId.getRawData();
+            const uint8 *delta = key.deltaId.getRawData();
+            const uint64 hash =
+                ByteOrder::littleEndianInt64(item) ^ ByteOrder::littleEndianInt64(item + 8) ^
+                ((ByteOrder::littleEndianInt64(delta) ^ ByteOrder::littleEndianInt64(delta + 8)) * 31);
+            return static_cast<int>((hash ^ (hash >> 32)) % static_cast<uint64>(upperLimit));
+        }
+    };
+
     class Pack :
         public Serializable,
         public ReferenceCountedObject
@@ -90,6 +116,14 @@ namespace VCS
 
         OwnedArray<PackDataBlock> unsavedData;
 
+        // Both headers and unsaved blocks are looked up by the pair of ids,
+        // once per delta on every checkout, so they are indexed
+        HashMap<PackDataKey, PackDataHeader *, PackDataKeyHashFunction> headersIndex;
+        HashMap<PackDataKey, PackDataBlock *, PackDataKeyHashFunction> unsavedDataIndex;
+
+        void indexHeader(PackDataHeader *header);
+        void indexUnsavedBlock(PackDataBlock *block);
+
         ScopedPointer<File> packFile;
 
         CriticalSection packStreamLock;
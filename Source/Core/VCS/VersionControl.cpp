@@ -121,6 +121,9 @@ void VersionControl::mergeWith(VersionControl &remoteHistory)
 {
     this->recursiveTreeMerge(this->getRoot(), remoteHistory.getRoot());
 
+    // the merge might have changed the existing revisions
+    this->head.invalidateSnapshots();
+
     this->publicId = remoteHistory.getPublicId();
     this->historyMergeVersion = remoteHistory.getVersion();
 
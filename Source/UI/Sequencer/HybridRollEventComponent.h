@@ -21,6 +21,7 @@ class MidiEvent;
 class MidiSequence;
 class HybridRoll;
 
+#include "CompactId.h"
 #include "FloatBoundsComponent.h"
 #include "SelectableComponent.h"
 
@@ -37,7 +38,7 @@ public:
     void setGhostMode();
 
     virtual float getBeat() const = 0;
-    virtual String getId() const = 0;
+    virtual CompactId::Type getId() const = 0;
 
     //===------------------------------------------------------------------===//
     // Component
@@ -62,7 +62,7 @@ String ClipComponent::getSelectionGroupId() const
     return this->clip.getPattern()->getTrackId();
 }
 
-String ClipComponent::getId() const
+Clip::Id ClipComponent::getId() const
 {
     return this->clip.getId();
 }
@@ -113,5 +113,5 @@ int ClipComponent::compareElements(ClipComponent *first, ClipComponent *second)
     if (first == second) { return 0; }
     const float diff = first->getBeat() - second->getBeat();
     const int diffResult = (diff > 0.f) - (diff < 0.f);
-    return (diffResult != 0) ? diffResult : (first->clip.getId().compare(second->clip.getId()));
+    return (diffResult != 0) ? diffResult : CompactId::compare(first->clip.getId(), second->clip.getId());
 }
@@ -41,7 +41,7 @@ public:
     void setSelected(bool selected) override;
     String getSelectionGroupId() const override;
     float getBeat() const override;
-    String getId() const override;
+    Clip::Id getId() const override;
 
     //===------------------------------------------------------------------===//
     // Component
@@ -134,7 +134,7 @@ String NoteComponent::getSelectionGroupId() const
     return this->midiEvent.getSequence()->getTrackId();
 }
 
-String NoteComponent::getId() const
+MidiEvent::Id NoteComponent::getId() const
 {
     return this->midiEvent.getId();
 }
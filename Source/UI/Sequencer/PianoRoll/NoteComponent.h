@@ -58,7 +58,7 @@ public:
     void setSelected(bool selected) override;
     String getSelectionGroupId() const override;
     float getBeat() const override;
-    String getId() const override;
+    MidiEvent::Id getId() const override;
 
     //===------------------------------------------------------------------===//
     // Component
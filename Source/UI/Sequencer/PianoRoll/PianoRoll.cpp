@@ -589,14 +589,31 @@ void PianoRoll::findLassoItemsInArea(Array<SelectableComponent *> &itemsFound, c
         note->setSelected(this->selection.isSelected(note));
     }
 
-    for (int i = 0; i < this->eventComponents.size(); ++i)
+    // only the active tracks' notes can be selected, so just ask their indices
+    // for the notes within the lasso's beat range, with a pixel to spare
+    const float startBeat = this->getBarByXPosition(rectangle.getX() - 1) * NUM_BEATS_IN_BAR;
+    const float endBeat = this->getBarByXPosition(rectangle.getRight() + 1) * NUM_BEATS_IN_BAR;
+
+    for (auto layer : this->activeLayers)
     {
-        NoteComponent *note = static_cast<NoteComponent *>(this->eventComponents.getUnchecked(i));
+        Array<Note *> notesInRange;
 
-        if (rectangle.intersects(note->getBounds()) && note->isActive())
+        if (auto pianoLayer = dynamic_cast<PianoSequence *>(layer))
         {
-            shouldInvalidateSelectionCache = true;
-            itemsFound.addIfNotAlreadyThere(note);
+            pianoLayer->findNotesInRange(startBeat, endBeat, notesInRange);
+        }
+
+        for (auto note : notesInRange)
+        {
+            NoteComponent *component = this->componentsHashTable[*note];
+
+            if (component != nullptr &&
+                component->isActive() &&
+                rectangle.intersects(component->getBounds()))
+            {
+                shouldInvalidateSelectionCache = true;
+                itemsFound.addIfNotAlreadyThere(component);
+            }
         }
     }
 
@@ -454,9 +454,11 @@ void PianoRollToolbox::wipeSpace(Array<MidiTrack *> tracks,
         if (nullptr != dynamic_cast<PianoSequence *>(sequence))
         {
             PianoSequence *layer = dynamic_cast<PianoSequence *>(sequence);
-            for (int j = 0; j < layer->size(); ++j)
+            Array<Note *> notesInRange;
+            layer->findNotesInRange(startBeat, endBeat, notesInRange);
+
+            for (auto note : notesInRange)
             {
-                Note *note = static_cast<Note *>(layer->getUnchecked(j));
                 const float noteStartBeat = note->getBeat();
                 const float noteEndBeat = note->getBeat() + note->getLength();
                 
@@ -504,15 +506,12 @@ void PianoRollToolbox::wipeSpace(Array<MidiTrack *> tracks,
         else if (nullptr != dynamic_cast<AutomationSequence *>(sequence))
         {
             AutomationSequence *layer = dynamic_cast<AutomationSequence *>(sequence);
-            for (int j = 0; j < layer->size(); ++j)
+            Array<AutomationEvent *> eventsInRange;
+            layer->findEventsInRange(startBeat, endBeat, eventsInRange);
+
+            for (auto event : eventsInRange)
             {
-                AutomationEvent *event = static_cast<AutomationEvent *>(layer->getUnchecked(j));
-                const bool shouldBeDeleted = (event->getBeat() < endBeat && event->getBeat() >= startBeat);
-                
-                if (shouldBeDeleted)
-                {
-                    autoRemoveGroup.add(*event);
-                }
+                autoRemoveGroup.add(*event);
             }
         }
     }
@@ -547,15 +546,14 @@ void PianoRollToolbox::shiftEventsToTheLeft(Array<MidiTrack *> tracks, float tar
         if (nullptr != dynamic_cast<PianoSequence *>(sequence))
         {
             PianoSequence *layer = dynamic_cast<PianoSequence *>(sequence);
-            for (int j = 0; j < layer->size(); ++j)
-            {
-                Note *note = static_cast<Note *>(layer->getUnchecked(j));
+            const NoteColumns &notes = layer->getColumns();
+            const int numNotesBefore = notes.indexOfFirstNoteAt(targetBeat);
 
-                if (note->getBeat() < targetBeat)
-                {
-                    pianoGroupBefore.add(*note);
-                    pianoGroupAfter.add(note->withDeltaBeat(beatOffset));
-                }
+            for (int j = 0; j < numNotesBefore; ++j)
+            {
+                const Note *note = notes.getNote(j);
+                pianoGroupBefore.add(*note);
+                pianoGroupAfter.add(note->withDeltaBeat(beatOffset));
             }
         }
         else if (nullptr != dynamic_cast<AnnotationsSequence *>(sequence))
@@ -575,15 +573,13 @@ void PianoRollToolbox::shiftEventsToTheLeft(Array<MidiTrack *> tracks, float tar
         else if (nullptr != dynamic_cast<AutomationSequence *>(sequence))
         {
             AutomationSequence *layer = dynamic_cast<AutomationSequence *>(sequence);
-            for (int j = 0; j < layer->size(); ++j)
+            const int numEventsBefore = layer->indexOfFirstEventAt(targetBeat);
+
+            for (int j = 0; j < numEventsBefore; ++j)
             {
                 AutomationEvent *event = static_cast<AutomationEvent *>(layer->getUnchecked(j));
-                
-                if (event->getBeat() < targetBeat)
-                {
-                    autoGroupBefore.add(*event);
-                    autoGroupAfter.add(event->withDeltaBeat(beatOffset));
-                }
+                autoGroupBefore.add(*event);
+                autoGroupAfter.add(event->withDeltaBeat(beatOffset));
             }
         }
     }
@@ -613,15 +609,13 @@ void PianoRollToolbox::shiftEventsToTheRight(Array<MidiTrack *> tracks, float ta
         if (nullptr != dynamic_cast<PianoSequence *>(sequence))
         {
             PianoSequence *layer = dynamic_cast<PianoSequence *>(sequence);
-            for (int j = 0; j < layer->size(); ++j)
+            const NoteColumns &notes = layer->getColumns();
+
+            for (int j = notes.indexOfFirstNoteAt(targetBeat); j < notes.size(); ++j)
             {
-                Note *note = static_cast<Note *>(layer->getUnchecked(j));
-                
-                if (note->getBeat() >= targetBeat)
-                {
-                    groupBefore.add(*note);
-                    groupAfter.add(note->withDeltaBeat(beatOffset));
-                }
+                const Note *note = notes.getNote(j);
+                groupBefore.add(*note);
+                groupAfter.add(note->withDeltaBeat(beatOffset));
             }
         }
         else if (nullptr != dynamic_cast<AnnotationsSequence *>(sequence))
@@ -641,15 +635,12 @@ void PianoRollToolbox::shiftEventsToTheRight(Array<MidiTrack *> tracks, float ta
         else if (nullptr != dynamic_cast<AutomationSequence *>(sequence))
         {
             AutomationSequence *layer = dynamic_cast<AutomationSequence *>(sequence);
-            for (int j = 0; j < layer->size(); ++j)
+
+            for (int j = layer->indexOfFirstEventAt(targetBeat); j < layer->size(); ++j)
             {
                 AutomationEvent *event = static_cast<AutomationEvent *>(layer->getUnchecked(j));
-                
-                if (event->getBeat() >= targetBeat)
-                {
-                    autoGroupBefore.add(*event);
-                    autoGroupAfter.add(event->withDeltaBeat(beatOffset));
-                }
+                autoGroupBefore.add(*event);
+                autoGroupAfter.add(event->withDeltaBeat(beatOffset));
             }
         }
     }